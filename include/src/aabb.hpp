@@ -0,0 +1,52 @@
+#include <cfloat>
+#include <utility>
+#include "transform.h"
+
+#ifndef AABB_HPP
+#define AABB_HPP
+
+//Axis aligned bounding box
+//An empty box has min > max, so extending it with anything gives that thing
+struct AABB
+{
+    vec3 min, max;
+
+    AABB() : min(vec3(FLT_MAX)), max(vec3(-FLT_MAX)) {}
+    AABB(const vec3 &lo, const vec3 &hi) : min(lo), max(hi) {}
+
+    //unbounded primitives (planes, ambient lights) report this
+    static AABB infinite() { return AABB(vec3(-FLT_MAX), vec3(FLT_MAX)); }
+
+    bool is_empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    bool is_infinite() const {
+        return min.x == -FLT_MAX || min.y == -FLT_MAX || min.z == -FLT_MAX ||
+               max.x == FLT_MAX || max.y == FLT_MAX || max.z == FLT_MAX;
+    }
+
+    void extend(const vec3 &p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void extend(const AABB &b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    vec3 center() const { return (min + max) * 0.5f; }
+
+    //slab test, inv_dir is 1 / ray direction
+    bool hit(const vec3 &origin, const vec3 &inv_dir, float tmin, float tmax) const {
+        for (int a = 0; a < 3; a++) {
+            float t0 = (min[a] - origin[a]) * inv_dir[a];
+            float t1 = (max[a] - origin[a]) * inv_dir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            if (t0 > tmin) tmin = t0;
+            if (t1 < tmax) tmax = t1;
+            if (tmax < tmin) return false;
+        }
+        return true;
+    }
+};
+
+#endif
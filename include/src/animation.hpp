@@ -0,0 +1,52 @@
+#include <vector>
+#include "transform.h"
+#include "objects.h"
+#include "glm/gtc/quaternion.hpp"
+
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+typedef glm::quat quat;
+
+//A pose at a point in time, applied as translate * rotate * scale
+struct Keyframe
+{
+    float time;
+    vec3 translation;
+    quat rotation;
+    vec3 scale;
+
+    Keyframe(float, vec3, quat rot=quat(), vec3 sc=vec3(1.0));
+    static quat axis_angle(const float degrees, const vec3& axis);
+    mat4 to_matrix() const;
+};
+
+//Keyframes for one object, kept sorted by time
+//Between keys translation and scale are linearly interpolated and rotation is
+//slerped. Before the first and after the last key the pose is held
+class AnimationTrack
+{
+public:
+    Object *obj;
+    std::vector<Keyframe> keys;
+
+    AnimationTrack(Object*);
+    void add_key(const Keyframe&);
+    mat4 evaluate(float) const;
+};
+
+class Animation
+{
+public:
+    float fps = 24.0;
+    std::vector<AnimationTrack> tracks;
+
+    Animation() {};
+
+    AnimationTrack& track(Object*);
+    //poses every animated object at time t, true if anything moved
+    bool apply(float);
+    float frame_time(int frame) const { return frame / fps; }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include <vector>
+#include "aabb.hpp"
+#include "frustum.hpp"
+#include "objects.h"
+#include "ray.h"
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+//Bounding volume hierarchy over scene objects
+//Nodes are stored depth first, so a child always comes after its parent and
+//refit() can rebuild every box with a single reverse sweep. Refitting keeps
+//the tree topology, which is what we want when only transforms change
+//between frames.
+
+class BVH
+{
+public:
+    struct Node
+    {
+        AABB box;
+        int right; //left child is always the next node
+        int first, count; //leaf range in prims, count == 0 for interior nodes
+    };
+
+    static const int LEAF_SIZE = 2;
+    static const int MAX_DEPTH = 64;
+
+    TaggedVector<Node, MemoryTag::bvh> nodes;
+    std::vector<Object*> prims;
+
+    BVH() {};
+
+    void build(const std::vector<Object*>&);
+    void refit();
+
+    //calls visit(Object*) for every object whose leaf box the ray enters
+    //before tmax. visit may lower tmax to prune the rest of the traversal
+    //the argument refers into prims, so a visitor taking Object *const& can
+    //recover the leaf index with &p - &prims[0]
+    template <typename Visitor>
+    void traverse(const Ray&, float &tmax, Visitor visit) const;
+
+    //collects the objects in leaves that overlap the frustum
+    //gives up and returns false once more than max objects are found
+    bool cull(const Frustum&, std::vector<Object*>&, unsigned int max) const;
+
+private:
+    int build_recursive(int, int, std::vector<vec3>&);
+};
+
+template <typename Visitor>
+void BVH::traverse(const Ray &ray, float &tmax, Visitor visit) const {
+    if (nodes.empty()) return;
+
+    //object hit distances are measured along the normalized direction
+    vec3 dir = glm::normalize(ray.direction);
+    vec3 inv_dir = vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (!node.box.hit(ray.origin, inv_dir, 0.0f, tmax)) continue;
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                visit(prims[i]);
+            }
+        }
+        else {
+            int left = (int)(&node - &nodes[0]) + 1;
+            stack[top++] = node.right;
+            stack[top++] = left;
+        }
+    }
+}
+
+#endif
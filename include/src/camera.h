@@ -1,10 +1,11 @@
 #include "variables.h"
 #include "transform.h"
+#include "memory_tags.hpp"
 
 #ifndef CAMERA_H
 #define CAMERA_H
 
-class Camera
+class Camera : public Tagged<MemoryTag::scene>
 {
 public:
 	float near = 1.0;
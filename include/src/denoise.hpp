@@ -0,0 +1,54 @@
+#include <vector>
+#include "transform.h"
+#include "thread_pool.hpp"
+
+#ifndef DENOISE_HPP
+#define DENOISE_HPP
+
+//Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010)
+//Each pass blurs with a 5x5 B3 spline kernel whose taps are spread 2^i pixels
+//apart, so a few passes cover a wide footprint for the price of 25 taps each.
+//Taps are weighted down where the colour, normal, albedo or depth of the
+//first hit differs from the centre pixel, which keeps geometric and texture
+//edges sharp while noise inside a surface is averaged away.
+
+//What the camera ray of each pixel hit first, row major like the image
+struct GuideBuffers
+{
+    int width = 0, height = 0;
+    std::vector<vec3> normal;
+    std::vector<vec3> albedo;
+    std::vector<float> depth; //negative where the ray missed everything
+
+    void resize(int, int);
+};
+
+class Denoiser
+{
+public:
+    int passes = 5;
+    float sigma_color = 0.5; //halves each pass, later passes only smooth fine noise
+    float sigma_normal = 0.1; //in 1 - cos of the angle between normals
+    float sigma_albedo = 0.1;
+    float sigma_depth = 1.0; //per pixel of tap distance
+
+    //filters rgb in place, rows are split over the pool
+    //the result doesn't depend on the number of threads
+    void run(std::vector<vec3> &rgb, const GuideBuffers&, ThreadPool&) const;
+
+private:
+    //colour and guides as one float plane per channel
+    struct Planes
+    {
+        int width, height;
+        const float *color[3];
+        const float *normal[3];
+        const float *albedo[3];
+        const float *depth;
+    };
+
+    //one pass into dst, rows [y0, y1)
+    void filter_rows(const Planes&, float *const dst[3], int step, float inv_color, int y0, int y1) const;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include <functional>
+#include <vector>
+#include "main.h"
+
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+//Local coordinator/worker tile rendering
+//The coordinator forks worker processes after the scene is set up, so every
+//worker starts with its own copy of the scene. Tiles go out over a unix socket
+//pair per worker and rendered pixels come back the same way.
+//A tile is handed out again if its worker dies, or if it has been running
+//longer than the timeout (whichever copy finishes first wins). A worker still
+//on the same tile after twice the timeout is killed like a dead one.
+
+typedef std::function<void (const Tile&, vec3*)> TileRenderer;
+typedef std::function<void (const Tile&, const vec3*)> TileSink;
+
+class TileCoordinator
+{
+public:
+    //index of the current worker process, -1 in the coordinator
+    static int worker_index;
+
+    int num_workers;
+    double timeout;
+    int reissued = 0;
+    int failed_workers = 0;
+
+    TileCoordinator(int, double);
+
+    //blocks until every tile has been passed to the sink
+    //tiles that no live worker can take are rendered in the coordinator
+    void render(const std::vector<Tile>&, TileRenderer, TileSink);
+
+private:
+    struct Worker
+    {
+        int pid;
+        int fd;
+        int tile; //-1 when idle
+        double started;
+    };
+
+    std::vector<Worker> workers;
+
+    void spawn(TileRenderer);
+    void shutdown();
+    static void worker_loop(int, TileRenderer);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "main.h"
+
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+//Render target that streams finished scanline bands to disk
+//The output is a binary PPM sized up front, so bands can be written at their
+//final offset in any order. A band is TILE_SIZE rows and is held in memory
+//only until its last tile arrives; a writer thread then flushes it while
+//rendering continues. With blocking on, a tile that would start a band beyond
+//max_bands waits for older bands to be written, so peak memory is
+//max_bands * band_rows * width * 3 bytes whatever the image height.
+//Blocking relies on tiles being handed out in row order (make_tiles order);
+//turn it off when a single thread receives tiles out of order.
+
+class StreamingImage
+{
+public:
+    int width, height, band_rows;
+    unsigned int max_bands;
+    bool blocking;
+    unsigned int peak_bands = 0; //most bands ever resident, for reporting
+
+    StreamingImage(const std::string&, int, int, int, unsigned int, bool block=true);
+    ~StreamingImage();
+
+    bool is_open() const { return fd >= 0; }
+    //thread safe
+    void write_tile(const Tile&, const vec3*);
+    //waits for every band to reach the disk, false if any write failed
+    bool close();
+
+private:
+    struct Band
+    {
+        TaggedVector<uint8_t, MemoryTag::framebuffer> rgb;
+        int pixels_left;
+    };
+
+    int fd;
+    long header_bytes;
+    bool failed = false;
+    bool stopping = false;
+    std::map<int, Band*> resident; //band index to band, until written
+    std::deque<int> finished; //bands waiting for the writer
+    std::mutex mutex;
+    std::condition_variable band_finished;
+    std::condition_variable band_written;
+    std::thread writer;
+
+    void writer_loop();
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "aabb.hpp"
+#include "transform.h"
+
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+//Bounding frustum of a packet of rays leaving one origin
+//Four side planes through the origin with inward normals, open at the far
+//end. It only ever rejects boxes, so it is conservative rather than tight:
+//a box that passes may still be missed by every ray.
+
+struct Frustum
+{
+    vec3 origin;
+    vec3 normals[4];
+
+    Frustum() {};
+    //corner directions in order around the packet, either winding
+    Frustum(const vec3 &origin, const vec3 corners[4]);
+
+    //false only when the box is certainly outside
+    bool overlaps(const AABB&) const;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef IMAGE_DIFF_HPP
+#define IMAGE_DIFF_HPP
+
+//Comparing rendered frames against reference images
+//Frames are compared as the 8 bit binary PPMs StreamingImage writes, so a
+//reference is just an earlier render kept under resources/golden.
+//PSNR catches broad drift (a light off by a few percent everywhere), the
+//max channel error catches a handful of pixels that are plain wrong.
+
+struct PPMImage
+{
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgb; //row major, top row first
+
+    //binary P6 with maxval 255 only, false for anything else
+    bool read(const std::string&);
+};
+
+struct ImageDiff
+{
+    double psnr = 0.0; //dB over every channel, INFINITY for identical images
+    int max_error = 0; //largest difference of a single channel, 0-255
+    long differing = 0; //pixels with any channel off
+
+    //images of different sizes get psnr 0 and max_error 255
+    static ImageDiff compare(const PPMImage&, const PPMImage&);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include <vector>
+#include "objects.h"
+#include "bvh.hpp"
+
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+//Geometry that can be placed many times in a scene
+//The primitives live in object space and own their own BVH (the bottom level).
+//A Geometry owns its primitives
+class Geometry : public Tagged<MemoryTag::scene>
+{
+public:
+    std::vector<Object*> prims;
+    BVH bvh;
+
+    Geometry() {};
+    ~Geometry();
+
+    void add(Object*);
+    void build(); //call once all primitives are added
+    AABB get_bounds() const;
+};
+
+//One placement of a Geometry
+//All an instance stores is the shared geometry pointer and its transform, so
+//the scene BVH over instances is the top level of a two level hierarchy.
+//Rays are moved into object space at the instance boundary
+class Instance : public Object
+{
+public:
+    const Geometry *geometry;
+
+    Instance(const Geometry*, mat4*, vec4);
+    bool intersects (const Ray&, vec3&, vec3&, float&, float&);
+    //prim is the index into geometry->bvh.prims
+    bool intersects (const Ray&, float, float, float&, int&);
+    void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
+    AABB get_bounds();
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "transform.h"
+#include "rng.hpp"
+
+#ifndef IRRADIANCE_CACHE_HPP
+#define IRRADIANCE_CACHE_HPP
+
+//Irradiance cache (Ward et al. 1988, gradients from Ward and Heckbert 1992)
+//Diffuse indirect light changes slowly over a surface, so it is sampled with
+//a full hemisphere of rays only at sparse points and interpolated in between.
+//Each record stores the irradiance, the harmonic mean distance to the
+//surfaces it saw (how far it can be trusted) and how the irradiance changes
+//when the point moves or the normal tilts, per colour channel.
+
+struct IrradianceRecord
+{
+    vec3 position, n;
+    vec3 irradiance;
+    float radius; //harmonic mean distance, clamped
+    vec3 grad_t[3]; //translational gradient per channel
+    vec3 grad_r[3]; //rotational gradient per channel
+};
+
+//Records live in a hash grid of cells twice the largest influence radius
+//across, and a record is stored in every cell its influence reaches. A lookup
+//then only reads the one cell holding the point. Cells are spread over shards
+//with one mutex each, so threads filling the cache rarely wait on each other.
+class IrradianceCache
+{
+public:
+    static const int SHARDS = 16;
+
+    //radiance arriving from a direction, returns the hit distance or INFINITY
+    typedef std::function<float (const vec3 &origin, const vec3 &dir, vec3 &radiance)> RadianceFn;
+
+    float error; //Ward's a, smaller is more accurate and needs more records
+    float min_radius, max_radius;
+
+    IrradianceCache(float error=0.4, float min_radius=0.2, float max_radius=4.0);
+
+    //weighted interpolation of the records around the point
+    //false when none is close enough, the caller should sample a new one
+    bool lookup(const vec3 &p, const vec3 &n, vec3 &irradiance) const;
+    //thread safe, concurrent duplicates are harmless
+    void insert(const IrradianceRecord&);
+    void clear();
+    long size() const { return count; }
+
+    //new record from a stratified theta x phi grid of cosine weighted rays
+    IrradianceRecord sample(const vec3 &p, const vec3 &n, int thetas, int phis, RandomStream&, const RadianceFn&) const;
+
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::vector<IrradianceRecord> > cells;
+    };
+
+    float cell_size;
+    mutable Shard shards[SHARDS];
+    std::atomic<long> count;
+
+    uint64_t cell_key(int, int, int) const;
+    Shard& shard_for(uint64_t) const;
+    void cell_of(const vec3&, int&, int&, int&) const;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "objects.h"
+#include "ray.h"
+#include "rng.hpp"
+
+#ifndef KERNEL_CHECK_HPP
+#define KERNEL_CHECK_HPP
+
+//Differential testing of intersection kernels
+//Every kernel variant registered for a primitive is run on the same generated
+//cases as the scalar reference for that primitive:
+//  sphere, plane, triangle: the original intersects(ray, hit, n, t0, t1)
+//  quadratic: Transform::solve_quadratic
+//Cases come from a seeded Philox stream, half uniformly random and half
+//adversarial (grazing rays, origins inside or on the surface, rays parallel
+//to planes, roots that cancel), so a failing run can be repeated exactly.
+//A ray kernel agrees with the reference when both miss, or both hit with t
+//no more than the tolerance apart in ULPs. Near t = 0 a few ULPs is nothing,
+//so values within an absolute distance agree too. Reference hits outside the
+//[tmin, tmax) window count as misses, that's the query the variants answer.
+//Each disagreement is shrunk (values zeroed, rounded, mantissa bits dropped)
+//for as long as it still disagrees, so the reproducer is as plain as it gets.
+
+class KernelCheck
+{
+public:
+    enum Kind { SPHERE, PLANE, TRIANGLE, QUADRATIC, KIND_COUNT };
+
+    //what a case's values mean depends on the kind
+    //  rays: origin 0-2, direction 3-5, tmin 6, tmax 7, then
+    //    sphere: center 8-10, radius 11
+    //    plane: normal 8-10, distance 11
+    //    triangle: vertices 8-16
+    //  quadratic: a, b, c in 0-2
+    static const int VALUES = 17;
+    struct Case
+    {
+        Kind kind;
+        float v[VALUES];
+    };
+
+    //same contract as Object::intersects(ray, tmin, tmax, t, prim)
+    typedef std::function<bool (Object*, const Ray&, float, float, float&)> Intersector;
+    typedef std::function<bool (float, float, float, float&, float&)> QuadraticSolver;
+
+    struct Result
+    {
+        bool hit = false;
+        float t0 = 0.0f, t1 = 0.0f; //t1 only for the quadratic
+    };
+
+    struct Mismatch
+    {
+        Case input; //shrunk
+        Result expected, actual;
+        uint32_t ulps; //UINT32_MAX when only one side hit
+    };
+
+    struct Report
+    {
+        std::string kernel;
+        Kind kind;
+        long cases = 0;
+        long mismatches = 0;
+        uint32_t max_ulps = 0; //worst distance among cases where both hit
+        std::vector<Mismatch> reproducers; //the first few
+    };
+
+    static const unsigned int MAX_REPRODUCERS = 4;
+
+    KernelCheck(uint32_t seed, uint32_t tolerance_ulps=0, float tolerance_absolute=0.0f);
+
+    void add(Kind, const std::string&, Intersector);
+    void add_quadratic(const std::string&, QuadraticSolver);
+    //the optimized paths the renderer uses in place of the references
+    void add_builtin();
+
+    //cases per kind, every kernel of a kind sees the same cases
+    std::vector<Report> run(long);
+
+    //runs a single case through the reference or a registered kernel
+    Result reference(const Case&) const;
+    Result evaluate(const std::string&, const Case&) const;
+
+    //steps between two floats, -0 and +0 are the same value
+    static uint32_t ulp_distance(float, float);
+    static const char* name(Kind);
+    static void write_case(std::ostream&, const Case&);
+    //one line per kernel, then every reproducer
+    static void write_report(std::ostream&, const std::vector<Report>&);
+
+private:
+    struct Entry
+    {
+        std::string name;
+        Kind kind;
+        Intersector intersect;
+        QuadraticSolver solve;
+    };
+
+    uint32_t seed;
+    uint32_t tolerance;
+    float absolute;
+    std::vector<Entry> kernels;
+
+    const Entry* find(const std::string&) const;
+    //the reference without the window applied
+    Result unwindowed(const Case&) const;
+    Result run_entry(const Entry&, const Case&) const;
+    bool near_edge(float t, float edge) const;
+    //true if the kernel disagrees with the reference, fills ulps
+    bool disagrees(const Entry&, const Case&, uint32_t &ulps) const;
+    Case shrink(const Entry&, const Case&) const;
+
+    static Case generate(Kind, RandomStream&, bool adversarial);
+};
+
+#endif
@@ -1,4 +1,18 @@
 #include "variables.h"
+#include "camera.h"
+#include "ray.h"
+#include "pixel.h"
+#include "FreeImage/FreeImage.h"
+#include "thread_pool.hpp"
+#include "animation.hpp"
+#include "ray_queue.hpp"
+#include "occluder_cache.hpp"
+#include "irradiance_cache.hpp"
+#include "profiler.hpp"
+#include "photon_map.hpp"
+#include "denoise.hpp"
+#include <string>
+#include <vector>
 
 #ifndef MAIN_H
 #define MAIN_H
@@ -6,4 +20,118 @@
 //Object objects[NUM_OBJECTS];
 //#define Object[NUM_OBJECTS] objects
 
-#endif
\ No newline at end of file
+const int TILE_SIZE = 32;
+
+//A rectangle of pixels [x0, x1) x [y0, y1) rendered as one unit of work
+struct Tile
+{
+    int x0, y0, x1, y1;
+
+    int width() const { return x1 - x0; }
+    int height() const { return y1 - y0; }
+    int size() const { return width() * height(); }
+};
+
+//Command line controlled settings for a render run
+struct RenderOptions
+{
+    int workers = 1; //processes, see TileCoordinator
+    int threads = 1; //threads per process
+    int frames = 1; //>1 renders the animation as a sequence
+    int instances = 0; //copies of the instanced tree added to the scene
+    int width = 1024;
+    int height = 768;
+    bool stream = false; //write bands to a PPM as they finish instead of holding the image
+    bool sort_rays = false; //trace secondary rays per tile in coherence order, see RayQueue
+    bool packets = true; //cull the scene against each tile's camera ray frustum first
+    bool shadow_rays = false; //darken camera hits that can't see a point light
+    bool occluder_cache = false; //try each light's last blocker before traversing
+    bool indirect = false; //add diffuse light bounced off other surfaces, see IrradianceCache
+    long photons = 0; //shot from the point lights before each frame, 0 skips the photon pass
+    size_t photon_memory = 256 << 20; //bytes, fewer photons are kept if they don't fit
+    size_t texture_memory = 64 << 20; //bytes of resident texture pages
+    std::string texture_cache; //directory for preprocessed texture files, empty for none
+    int reflections = 0; //deepest mirror bounce followed, 0 keeps MAX_REFLECTIONS
+    bool roulette = false; //end paths that carry little light early, without bias
+    bool specialize = true; //kernel compiled for the scene's features, false takes the most general one
+    bool denoise = false; //filter the finished frame before it's saved, see Denoiser
+    bool counters = false; //hardware event counts per phase in the timing report
+    bool bench = false; //time the hot kernels on their own instead of rendering
+    std::string timeline; //Chrome trace of every timed span goes here, empty for none
+    std::string output = "./test/test.png";
+};
+
+Camera* world_setup(const RenderOptions &options=RenderOptions(), ThreadPool *pool=NULL);
+//builds the BVH over bounded objects, the rest go to the unbounded list
+//point lights also get a slot in the shadow ray light list
+void compile_scene();
+void world_teardown(Camera*);
+
+//Camera hits waiting for one batched photon map lookup, see render_tile_sorted
+struct PhotonBatch
+{
+    std::vector<PhotonQuery> queries;
+    std::vector<Pixel*> pixels;
+};
+
+//How camera hits test the point lights
+enum class ShadowMode
+{
+    none=0,
+    traced, //every light every time
+    cached //the light's last blocker first, see OccluderCache
+};
+
+//Compile time feature set of the integrator
+//The trace and shade functions are templated on this, and every combination
+//the renderer can ask for is instantiated once, see select_integrator. A
+//feature a kernel leaves out is a constant the compiler folds away, not a
+//branch taken per ray.
+template <bool Textures, ShadowMode Shadows, int MaxDepth, bool Tracking>
+struct FeaturePolicy
+{
+    static const bool textures = Textures; //false shades every object with its colour
+    static const ShadowMode shadows = Shadows;
+    static const int max_depth = MaxDepth; //0 reads the limit from the TraceContext
+    static const bool tracking = Tracking; //prints every ray traced
+};
+
+//Per-thread state handed down through trace_ray
+struct TraceContext
+{
+    RayQueue *deferred = NULL; //secondary rays are pushed here instead of traced right away
+    bool shadow_rays = false;
+    OccluderCache *occluders = NULL; //NULL always traverses
+    IrradianceCache *irradiance = NULL; //NULL leaves out indirect light
+    const PhotonMap *photons = NULL; //NULL leaves out light from the photon map
+    PhotonBatch *photon_batch = NULL; //photon lookups wait here instead of running right away
+    int max_reflections = 0; //0 keeps MAX_REFLECTIONS
+    bool roulette = false;
+};
+
+//picks the kernel from the context, render_tile picks it once per tile
+void trace_ray(Ray*, Pixel&, int, bool track=false, const TraceContext *context=NULL);
+//the kernel render_tile would run with these options on the current scene
+std::string integrator_name(const RenderOptions&);
+//true if something other than a light blocks the way from the point to the
+//scene light in that slot, see compile_scene
+bool occluded(const vec3&, int, OccluderCache *cache=NULL);
+//closest hit and shadow queries made on the calling thread so far
+long rays_cast();
+//shoots photons from the point lights on the pool and builds photon_map
+//photon i's path only depends on i, so the map is the same for any thread count
+void emit_photons(long, ThreadPool&);
+
+std::vector<Tile> make_tiles(Camera*, int);
+//renders a tile into a row-major rgb buffer of tile.size() entries
+void render_tile(Camera*, const Tile&, vec3*, const RenderOptions &options=RenderOptions());
+//first hit normal, albedo and depth through each pixel centre, for the denoiser
+void render_guides(Camera*, const Tile&, GuideBuffers&);
+void write_tile(FIBITMAP*, Camera*, const Tile&, const vec3*);
+void tracer(Camera*, const RenderOptions&, ThreadPool&, const std::string&);
+void animation_setup(Animation&);
+void render_sequence(Camera*, Animation&, const RenderOptions&, ThreadPool&);
+//runs each kernel over the same random camera rays on this thread, one timer per kernel
+void benchmark_kernels(Camera*);
+
+#endif
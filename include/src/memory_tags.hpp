@@ -0,0 +1,87 @@
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <ostream>
+#include <vector>
+
+#ifndef MEMORY_TAGS_HPP
+#define MEMORY_TAGS_HPP
+
+//Memory accounting by subsystem
+//Allocations are charged to a tag and released from it again, and every tag
+//keeps its current and peak bytes. Three ways in:
+//  TaggedAllocator / TaggedVector for containers,
+//  deriving from Tagged<tag> for classes that are new'd one at a time,
+//  MemoryAccount::allocated/released for memory owned by a library
+//  (FreeImage bitmaps).
+//Bytes still charged after teardown are leaks.
+
+enum class MemoryTag { scene, bvh, textures, framebuffer, tracker, rays, COUNT };
+
+class MemoryAccount
+{
+public:
+    static void allocated(MemoryTag, size_t);
+    static void released(MemoryTag, size_t);
+
+    static long current(MemoryTag);
+    static long peak(MemoryTag);
+    //peaks restart from the current bytes
+    static void reset_peaks();
+
+    static const char* name(MemoryTag);
+    static void write_report(std::ostream&);
+
+private:
+    static std::atomic<long> current_bytes[(int)MemoryTag::COUNT];
+    static std::atomic<long> peak_bytes[(int)MemoryTag::COUNT];
+};
+
+template <class T, MemoryTag Tag>
+struct TaggedAllocator
+{
+    typedef T value_type;
+    //the tag isn't a type, so allocator_traits can't work this out itself
+    template <class U> struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+    TaggedAllocator() {}
+    template <class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        T *p = static_cast<T*>(::operator new(n * sizeof(T)));
+        MemoryAccount::allocated(Tag, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T *p, size_t n) {
+        MemoryAccount::released(Tag, n * sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+template <class T, class U, MemoryTag Tag>
+bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return true; }
+template <class T, class U, MemoryTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return false; }
+
+template <class T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag> >;
+
+//new and delete of the derived class charge the tag
+//delete through a base pointer needs a virtual destructor to get the size right
+template <MemoryTag Tag>
+struct Tagged
+{
+    static void* operator new(size_t size) {
+        void *p = ::operator new(size);
+        MemoryAccount::allocated(Tag, size);
+        return p;
+    }
+
+    static void operator delete(void *p, size_t size) {
+        MemoryAccount::released(Tag, size);
+        ::operator delete(p);
+    }
+};
+
+#endif
@@ -1,25 +1,37 @@
 #include "transform.h"
 #include "variables.h"
 #include "ray.h"
+#include "aabb.hpp"
+#include "memory_tags.hpp"
 
 #ifndef OBJECTS_H
 #define OBJECTS_H
 
-//TODO: Not currently used, but  perhaps should replace the struct in main
-/*
-struct HitStruct
+class Object;
+
+//What the closest hit search carries from candidate to candidate
+//Kept small on purpose, everything needed for shading is derived afterwards
+//for the winning hit only
+struct HitRecord
 {
-    bool contact;   //did hit?
-    vec3 hit;       //hit point
-    vec3 n;         //n vector to hit area
-    float t0;       //near hit distance
-    float t1;       //far hit distance
+    float t = INFINITY;     //distance along the normalized ray direction
+    Object *object = NULL;  //NULL until something is hit
+    int prim = 0;           //primitive inside the object, see intersects
 };
-*/
+
+//Shading inputs for one hit
+struct SurfaceInteraction
+{
+    vec3 position;  //hit point, pulled back by the object's easing distance
+    vec3 n;         //surface normal at the hit
+    float u = 0.0;  //texture coordinates, only set for textured objects
+    float v = 0.0;
+};
+
 //This is a pure virtual class that allows
 //us to create an array of pointers to various subclasses
 
-class Object
+class Object : public Tagged<MemoryTag::scene>
 {
 public:
     static int id_generator;
@@ -27,7 +39,7 @@ public:
 
     ObjType type;
 	vec4 color;
-    bool has_texture;
+    bool has_texture = false;
     std::string texture_filepath;
     float easing_distance;
 	mat4 objectToWorld, worldToObject;
@@ -35,7 +47,17 @@ public:
 	Object();
 	Object(mat4*, vec4, float, bool, std::string);
 	Object(mat4*, vec4, float, int); //testing constructor with id
+    virtual ~Object() {};
 	virtual bool intersects (const Ray&, vec3&, vec3&, float&, float&) =0;
+    //closest hit query, only hits with tmin <= t < tmax count
+    //t is along the normalized ray direction and prim picks out the primitive
+    //inside compound objects (0 otherwise). Callers shrink tmax as hits are
+    //found so farther objects bail out before doing any real work
+    virtual bool intersects (const Ray&, float, float, float&, int&);
+    //hit point, normal and uv for a record filled in by the query above
+    virtual void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
+    virtual AABB get_bounds(); //world space, infinite unless overridden
+    virtual void set_transform(const mat4&); //moves the object, e.g. between animation frames
 };
 
 class Sphere : public Object
@@ -53,6 +75,10 @@ public:
 	Sphere(float, mat4*, vec4 col, float, int); //testing constructor
     Sphere(const Sphere&); //copy
 	bool intersects (const Ray&, vec3&, vec3&, float&, float&);
+    bool intersects (const Ray&, float, float, float&, int&);
+    void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
+    AABB get_bounds();
+    void set_transform(const mat4&);
     float get_phi(const vec3&);
     float get_theta(const vec3&, const float&);
     float get_v(const float&);
@@ -70,6 +96,10 @@ public:
 
 	Light(float, mat4*, vec4, float, LightType);
 	bool intersects (const Ray&, vec3&, vec3&, float&, float&);
+    bool intersects (const Ray&, float, float, float&, int&);
+    void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
+    AABB get_bounds();
+    void set_transform(const mat4&);
 
 	//bool intersects_point(const Ray*, vec3*, vec3*, float*, float*);
 	//bool intersects_ambient(const Ray*, vec3*, vec3*, float*, float*);
@@ -83,6 +113,9 @@ public:
 
 	Triangle(vec3 A, vec3 B, vec3 C, vec4 col);
 	bool intersects (const Ray&, vec3&, vec3&, float&, float&);
+    bool intersects (const Ray&, float, float, float&, int&);
+    void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
+    AABB get_bounds();
 };
 
 class Plane : public Object
@@ -94,6 +127,8 @@ public:
 	//Plane(vec3 A, vec3 B, vec3 C, vec4 col);
 	Plane(vec3, float, vec4, float);
     bool intersects (const Ray&, vec3&, vec3&, float&, float&);
+    bool intersects (const Ray&, float, float, float&, int&);
+    void compute_surface_interaction (const Ray&, const HitRecord&, SurfaceInteraction&);
 };
 /*
 class Polygon : public Object {
@@ -0,0 +1,29 @@
+#include <vector>
+#include "objects.h"
+
+#ifndef OCCLUDER_CACHE_HPP
+#define OCCLUDER_CACHE_HPP
+
+//Last object that blocked a shadow ray, per light
+//Neighbouring shading points tend to be shadowed by the same thing, so that
+//object is tested first and a hit skips the traversal. One cache belongs to
+//one thread for the duration of a tile, so there is no locking; the counts
+//are summed into the global statistics when the tile is done.
+
+class OccluderCache
+{
+public:
+    long lookups = 0; //shadow rays that had a cached occluder to try
+    long hits = 0; //of those, how many it still blocked
+
+    OccluderCache(int lights);
+
+    Object* get(int light) const { return last[light]; }
+    void set(int light, Object *obj) { last[light] = obj; }
+    void clear();
+
+private:
+    std::vector<Object*> last;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <string>
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+//Hardware event counts for the calling thread through perf_event_open
+//The events are opened as one group so a single read() returns all of them
+//from the same instant. Events the kernel or the machine won't provide (no
+//PMU in a VM, perf_event_paranoid, missing cache events) are left out and
+//read as zero; if none open, available() is false and nothing is counted.
+//Readings are raw totals. When the kernel multiplexes the group, the share of
+//time it actually counted changes as the run goes on, so only the difference
+//between two readings is scaled up, by that interval's own share.
+
+class PerfCounters
+{
+public:
+    enum Event { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, EVENTS };
+
+    //counts the thread that constructs it, from then on
+    PerfCounters();
+    ~PerfCounters();
+
+    bool available() const { return leader >= 0; }
+    bool has(int event) const { return slot[event] >= 0; }
+    //why nothing opened, empty when available
+    const std::string& error() const { return failure; }
+
+    struct Reading
+    {
+        uint64_t values[EVENTS] = {0}; //unscaled totals per Event
+        uint64_t enabled = 0; //ns the group was enabled
+        uint64_t running = 0; //ns it was on the PMU
+    };
+
+    void read(Reading&) const;
+    //counts per Event between two readings of the same counters
+    static void difference(const Reading &start, const Reading &end, uint64_t out[EVENTS]);
+
+    static const char* name(int event);
+
+private:
+    int fds[EVENTS];
+    int slot[EVENTS]; //position in the group read, -1 when not open
+    int leader = -1;
+    int members = 0;
+    std::string failure;
+
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include <cstddef>
+#include <vector>
+#include "transform.h"
+#include "thread_pool.hpp"
+
+#ifndef PHOTON_MAP_HPP
+#define PHOTON_MAP_HPP
+
+//Photon map (Jensen 1996)
+//Photons shot from the lights are stored where they land on surfaces, and the
+//light arriving at a shading point is estimated from the density of its k
+//nearest photons. The map is a left-balanced kd-tree laid out implicitly as a
+//heap: node i has children 2i + 1 and 2i + 2, so there are no child pointers
+//and a query walks one flat array.
+
+//20 bytes, power as shared exponent rgb and the direction as two angles
+struct Photon
+{
+    float position[3];
+    unsigned char power[4]; //rgbe
+    unsigned char theta, phi; //direction of travel
+    short axis; //splitting axis once in the tree
+
+    static Photon pack(const vec3 &position, const vec3 &power, const vec3 &direction);
+    vec3 get_position() const { return vec3(position[0], position[1], position[2]); }
+    vec3 get_power() const;
+    void set_power(const vec3&);
+    vec3 get_direction() const;
+};
+
+struct PhotonQuery
+{
+    vec3 position, n;
+};
+
+class PhotonMap
+{
+public:
+    //the budget covers the peak while building, two copies of every photon
+    PhotonMap(size_t budget_bytes);
+
+    //photons that fit the budget
+    size_t capacity() const { return max_photons; }
+    size_t size() const { return tree.size(); }
+    size_t bytes() const { return tree.size() * sizeof(Photon); }
+    bool empty() const { return tree.empty(); }
+    void clear();
+
+    //takes the photons in any order and lays them out as the tree
+    //the top of the tree is split on the calling thread, then whole subtrees
+    //are handed to the pool
+    void build(std::vector<Photon> &photons, ThreadPool &pool);
+
+    //indices into nodes() of the k nearest photons within max_radius,
+    //nearest first
+    void nearest(const vec3 &p, int k, float max_radius, std::vector<int> &found) const;
+
+    //irradiance from photons arriving at the front of the surface, divided
+    //by the area of the disc that holds them
+    vec3 irradiance(const vec3 &p, const vec3 &n, int k, float max_radius) const;
+    //same for many points, visited in spatial order so consecutive queries
+    //walk the same part of the tree
+    void irradiance_batch(const std::vector<PhotonQuery> &queries, int k, float max_radius, std::vector<vec3> &out) const;
+
+    const std::vector<Photon>& nodes() const { return tree; }
+
+private:
+    typedef std::pair<float, int> Candidate; //squared distance, node
+
+    size_t max_photons;
+    std::vector<Photon> tree;
+
+    struct Range
+    {
+        size_t begin, end, node;
+    };
+
+    void build_range(std::vector<Photon> &photons, const Range&);
+    void split(std::vector<Photon> &photons, const Range&, Range &left, Range &right);
+    void search(size_t node, const vec3 &p, int k, float &max_dist2, std::vector<Candidate> &heap) const;
+    vec3 estimate(const vec3 &p, const vec3 &n, int k, float max_radius, std::vector<Candidate> &heap) const;
+    static size_t left_size(size_t);
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "perf_counters.hpp"
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+//Hierarchical phase timing
+//A ScopedTimer adds the monotonic wall time and the thread's CPU time
+//between its construction and destruction to a node named after it, nested
+//under whatever timers are open on the same thread. Every thread keeps its
+//own tree, so timing takes no locks after a thread's first timer; the trees
+//are merged by path when a report is written.
+//Work handed to other threads can be nested under the phase that handed it
+//out by passing that phase's path() to the timer on the other thread.
+//
+//In the reports, wall and cpu are summed over the threads that ran a node.
+//Its percentage is of its parent's wall time for every such thread, so a
+//phase spread over 4 threads that kept all of them busy reads 100%.
+//
+//With counters on, every timer also reads the thread's hardware event counts
+//(perf_counters.hpp) and the reports add them, per ray where a phase has rays.
+//
+//With the timeline on, every timed span is also kept as an event in its
+//thread's own buffer, appended without locks, and write_timeline() exports
+//them in the Chrome trace event format (chrome://tracing, Perfetto).
+
+class Profiler
+{
+public:
+    typedef std::vector<const char*> Path;
+
+    Profiler();
+    ~Profiler();
+
+    //names are kept by pointer, use string literals
+    void begin(const char *name);
+    void end();
+    //rays cast inside this thread's innermost open timer
+    void add_rays(long);
+    //tags this thread's innermost open timer's timeline event, e.g. a tile index
+    void annotate(long);
+    //this thread's open timers, outermost first
+    Path path();
+
+    //hardware counters for timers started after the next reset()
+    void use_counters(bool);
+    //why counters were asked for but none could be opened, empty otherwise
+    std::string counters_error();
+
+    //timeline events for timers started after the next reset()
+    void use_timeline(bool);
+
+    //drops everything recorded and restarts the run clock
+    void reset();
+    //wall seconds since construction or reset, the report's root
+    double elapsed() const;
+
+    void write_text(std::ostream&);
+    void write_json(std::ostream&);
+    void write_timeline(std::ostream&);
+
+    static double wall_now();
+    static double cpu_now(); //of the calling thread
+    static double process_cpu_now(); //of every thread
+
+private:
+    struct Node
+    {
+        const char *name;
+        int parent;
+        std::vector<int> children;
+        long calls = 0;
+        double wall = 0.0, cpu = 0.0;
+        long rays = 0;
+        double wall_start = 0.0, cpu_start = 0.0;
+        uint64_t events[PerfCounters::EVENTS] = {0};
+        PerfCounters::Reading events_start;
+    };
+
+    struct Open
+    {
+        int node;
+        bool timed; //false for parents borrowed from another thread
+        long tag;
+    };
+
+    struct Event
+    {
+        const char *name;
+        double start, duration; //seconds since the run clock started
+        int depth;
+        long tag; //-1 for none
+    };
+
+    struct ThreadProfile
+    {
+        int index; //the trace's thread id
+        std::thread::id owner;
+        std::vector<Node> nodes; //nodes[0] is the root
+        std::vector<Open> stack;
+        PerfCounters *counters = NULL; //NULL when off or unavailable
+        bool record = false;
+        std::vector<Event> events;
+        long dropped = 0; //events past TIMELINE_LIMIT
+    };
+
+    //a merged node, threads counts the threads that ran it
+    struct Summary
+    {
+        const char *name;
+        long calls = 0;
+        double wall = 0.0, cpu = 0.0;
+        long rays = 0;
+        uint64_t events[PerfCounters::EVENTS] = {0};
+        int threads = 0;
+        std::vector<Summary> children;
+    };
+
+    uint64_t id; //tells threads their cached profile is stale
+    double started, cpu_started;
+    bool counters = false;
+    bool timeline = false;
+    std::string counter_failure;
+    std::mutex mutex;
+    std::vector<ThreadProfile*> threads;
+
+    ThreadProfile* local();
+    void open(const char *name, bool timed);
+    static int child(ThreadProfile*, int parent, const char *name);
+    static void merge(const ThreadProfile*, int node, Summary&);
+    static long total_rays(Summary&);
+    Summary summarize();
+
+    friend class ScopedTimer;
+    static void write_text(std::ostream&, const Summary&, double parent_wall, int depth);
+    static void write_counters(std::ostream&, const Summary&, int depth);
+    void write_json(std::ostream&, const Summary&, double parent_wall, int depth);
+};
+
+class ScopedTimer
+{
+public:
+    ScopedTimer(Profiler&, const char *name);
+    //nested under a path taken on another thread
+    ScopedTimer(Profiler&, const char *name, const Profiler::Path &parent);
+    ~ScopedTimer();
+
+private:
+    Profiler &profiler;
+    int opened; //including the borrowed parents
+
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+};
+
+#endif
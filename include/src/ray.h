@@ -1,17 +1,21 @@
 #include "transform.h"
 #include "variables.h"
+#include "memory_tags.hpp"
 #include <ostream>
+#include <atomic>
 
 #ifndef RAY_H
 #define RAY_H
 
-class Ray
+//rays are new'd per sample, the heap ones are charged to the rays tag
+class Ray : public Tagged<MemoryTag::rays>
 {
 public:
-    static int id_generator;
+    static std::atomic<int> id_generator; //rays are created on every render thread
     int id;
     vec3 origin, direction;
 	RayType type;
+    float throughput = 1.0; //share of the light found at the end that reaches the pixel
 
 	Ray(vec3, vec3, RayType);
 	Ray(vec3, vec3, RayType, int); //id constructor for testing
@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <vector>
+#include "aabb.hpp"
+#include "variables.h"
+#include "pixel.h"
+
+#ifndef RAY_QUEUE_HPP
+#define RAY_QUEUE_HPP
+
+//Deferred secondary rays for one tile
+//Reflection rays leave in scattered directions, so tracing each one right
+//after its parent walks a different part of the BVH every time. Collecting a
+//tile's worth first and sorting them by direction octant and origin cell lets
+//neighbouring rays in the queue visit the same nodes and objects back to back.
+
+struct QueuedRay
+{
+    vec3 origin, direction;
+    RayType type;
+    Pixel *pixel; //sample the ray contributes to
+    int reflections; //depth reached so far, as passed to trace_ray
+    float throughput; //see Ray
+};
+
+class RayQueue
+{
+public:
+    //origin cells per axis, keys hold 3 bits of octant and 3 * 8 bits of cell
+    static const int CELL_BITS = 8;
+
+    TaggedVector<QueuedRay, MemoryTag::rays> rays;
+
+    RayQueue() {};
+
+    void push(const QueuedRay &ray) { rays.push_back(ray); }
+    bool empty() const { return rays.empty(); }
+    unsigned int size() const { return rays.size(); }
+    void clear() { rays.clear(); }
+    void swap(RayQueue &other) { rays.swap(other.rays); }
+
+    //reorders rays into coherence key order, stable for equal keys
+    void sort();
+
+    //direction octant in the high bits, then the morton code of the origin's
+    //cell inside bounds
+    static uint32_t coherence_key(const vec3&, const vec3&, const AABB&);
+
+    //stable LSD radix sort of keys, values are carried along
+    static void radix_sort(std::vector<uint32_t> &keys, std::vector<int> &values);
+
+private:
+    std::vector<uint32_t> keys;
+    std::vector<int> order;
+    TaggedVector<QueuedRay, MemoryTag::rays> scratch;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include <cstdint>
+
+#ifndef RNG_HPP
+#define RNG_HPP
+
+//Counter-based random numbers (Philox4x32-10, Salmon et al. 2011)
+//There is no generator state to share between threads: every value is a pure
+//function of a key and a counter, so a sample drawn for a given pixel, sample
+//index and bounce is the same no matter which thread or tile order produced it
+
+class Philox
+{
+public:
+    static const int ROUNDS = 10;
+
+    //one block of 4 random words
+    static void generate(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+
+    //batch version over n counters laid out as structure of arrays
+    //the lanes are independent so the round loop vectorizes
+    static void generate_batch(
+        const uint32_t *c0, const uint32_t *c1, const uint32_t *c2, const uint32_t *c3,
+        const uint32_t key[2], int n,
+        uint32_t *o0, uint32_t *o1, uint32_t *o2, uint32_t *o3);
+
+    //maps the top 24 bits to [0, 1)
+    static float to_float(uint32_t);
+};
+
+//A stream of uniform floats keyed by pixel, sample and bounce
+//Streams are cheap to construct, so make one where it's needed instead of
+//passing one around
+class RandomStream
+{
+public:
+    uint32_t key[2];
+    uint32_t counter[4];
+
+    RandomStream(uint32_t seed, int px, int py, int sample, int bounce);
+
+    float next_float();
+    void next_floats(float*, int);
+
+private:
+    uint32_t block[4];
+    int used;
+
+    void refill();
+};
+
+#endif
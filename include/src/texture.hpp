@@ -1,24 +1,35 @@
-#include <map>
 #include <string>
+#include <vector>
 #include "FreeImage/FreeImage.h"
+#include "profiler.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
 #include "transform.h"
 
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
 //This is a basic texture manager
-//It can load an image serving as a texture and save a reference to it
+//It decodes images serving as textures through FreeImage and keeps them in a
+//page cache under a memory budget, so a scene with many large textures only
+//holds the pages it actually samples
 //Given a u and a v value, it can return a pixel color from that image
-//That's it for now, maybe additional improvements later
 
 class TextureManager
 {
 public:
-    static std::map<std::string, FIBITMAP*> texture_handler_map;
+    static TextureCache cache;
     TextureManager () {};
-    //NOTE: Include custom destructor method to close all the file handles
 
+    //the caller unloads the bitmap
     static FIBITMAP* load_image (const std::string&, int);
+    //decoder for the cache
+    //each call works on its own bitmap, so different textures decode side by side
+    static bool decode (const std::string&, DecodedImage&);
+    //queues every path for decoding on the pool and returns straight away
+    //pool.wait() to know they are in; each decode is timed as "decode" under
+    //the caller's open timers
+    static void preload (const std::vector<std::string>&, ThreadPool&, Profiler&);
     static bool get_uv_pixel_color (vec3&, const std::string&, const float&, const float&);
 
 };
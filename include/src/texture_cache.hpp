@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memory_tags.hpp"
+#include "transform.h"
+
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+class TextureFile;
+
+//Texture pages under a memory budget
+//Textures are split into square pages per mip level and only pages that get
+//sampled have to stay resident. When the budget is full, CLOCK picks the page
+//to drop: every page has a referenced bit that lookups set, and the hand
+//clears bits as it sweeps until it finds a page nobody touched since its
+//last pass. Pages are spread over shards with a mutex each, so threads
+//sampling different pages don't wait on each other.
+//
+//A page miss decodes the source image and builds the page from it. The same
+//decode also fills other pages of the texture, but only into free budget,
+//never by evicting, and those pages start unreferenced so they go first.
+//The first decode of an image also writes it out as a preprocessed texture
+//file (texture_file.hpp), and from then on misses copy the page out of the
+//mapped file instead, so an evicted page never costs another decode. With a
+//file directory set the file is kept for later runs; without one it goes to
+//an unlinked file in $TMPDIR that disappears with the mapping.
+
+//8 bit rgb, row major, as a decoder hands it over
+struct DecodedImage
+{
+    int width = 0, height = 0;
+    TaggedVector<unsigned char, MemoryTag::textures> rgb;
+};
+
+class TextureCache
+{
+public:
+    static const int PAGE_SIZE = 64; //texels per side
+    static const int SHARDS = 16;
+    static const size_t PAGE_BYTES = PAGE_SIZE * PAGE_SIZE * 3;
+
+    //reads a whole image, false if it can't
+    typedef std::function<bool (const std::string&, DecodedImage&)> Decoder;
+
+    std::atomic<long> hits, misses, evictions, decodes;
+    std::atomic<long> mapped; //misses served from a texture file
+
+    TextureCache(size_t budget_bytes, Decoder);
+    ~TextureCache();
+
+    //a budget under one page still keeps one page
+    void set_budget(size_t);
+    size_t budget() const { return max_bytes; }
+    size_t resident_bytes() const { return resident; }
+
+    //where texture files are read and written, empty for none
+    //set before the first lookup
+    void set_file_directory(const std::string&);
+
+    //size of a mip level, level 0 is the image itself
+    //false if the texture can't be decoded or has no such level
+    bool level_size(const std::string&, int level, int &width, int &height);
+    //texel of a mip level, false outside it
+    bool texel(const std::string&, int level, int x, int y, vec3 &rgb);
+
+    //drops every page, they come back from the texture files on their next use
+    void clear();
+
+    //page (tx, ty) of an image as PAGE_BYTES, zero padded past its edge
+    static void copy_page(const DecodedImage&, int tx, int ty, unsigned char *out);
+
+private:
+    struct Texture
+    {
+        int id;
+        std::mutex decode_mutex; //one decode per texture at a time
+        std::atomic<bool> probed;
+        bool ok = false;
+        std::vector<int> widths, heights; //per level
+        TextureFile *file = NULL;
+    };
+
+    struct Page
+    {
+        TaggedVector<unsigned char, MemoryTag::textures> rgb; //PAGE_SIZE x PAGE_SIZE, padded at the image edge
+        bool referenced;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Page*> pages;
+    };
+
+    Decoder decoder;
+    std::string file_directory;
+    size_t max_bytes;
+    std::atomic<size_t> resident;
+    Shard shards[SHARDS];
+
+    std::mutex registry_mutex;
+    std::map<std::string, Texture*> textures;
+
+    //CLOCK ring over every resident page, taken before any shard mutex
+    std::mutex clock_mutex;
+    std::vector<uint64_t> ring;
+    size_t hand = 0;
+
+    Texture* texture(const std::string&);
+    bool in_level(Texture*, int level, int x, int y) const;
+    bool lookup(uint64_t key, int x, int y, vec3 &rgb);
+    bool page_in(Texture*, const std::string&, int level, int x, int y, vec3 *rgb);
+    bool page_from_file(Texture*, int level, int x, int y, vec3 &rgb);
+    bool insert(uint64_t key, Page*, bool evict);
+    void evict_one();
+
+    static uint64_t page_key(int texture, int level, int tx, int ty);
+    Shard& shard_for(uint64_t key);
+    static void build_mips(const DecodedImage&, std::vector<DecodedImage>&);
+    static Page* build_page(const DecodedImage&, int tx, int ty);
+    static void use_file(Texture*, TextureFile*);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "texture_cache.hpp"
+
+#ifndef TEXTURE_FILE_HPP
+#define TEXTURE_FILE_HPP
+
+//Preprocessed texture files
+//A texture decoded once is written out already tiled: every mip level cut
+//into TextureCache pages of 8 bit rgb, uncompressed, so a page is one fixed
+//size slice of the file. Later runs map the file and copy pages straight out
+//of it instead of going through the image decoder.
+//Files are named by a hash of the source image's bytes, so an edited image
+//gets a new file and renamed copies share one.
+//
+//layout, native byte order
+//  header: "RTTX", version, page size, level count, source hash
+//  levels: width, height, byte offset of the level's first page
+//  pages:  per level, row major, PAGE_BYTES each
+
+class TextureFile
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    ~TextureFile();
+
+    //FNV-1a over the file's bytes, false if it can't be read
+    static bool content_hash(const std::string &path, uint64_t &hash);
+    static std::string cache_path(const std::string &dir, uint64_t hash);
+
+    //writes beside the target and renames, so readers never see half a file
+    static bool write(const std::string &file, uint64_t hash, const std::vector<DecodedImage> &levels);
+    //NULL if the file is missing or isn't a complete texture file
+    static TextureFile* open(const std::string &file);
+
+    int levels() const { return table.size(); }
+    int width(int level) const { return table[level].width; }
+    int height(int level) const { return table[level].height; }
+    uint64_t hash() const { return source_hash; }
+    //PAGE_BYTES of the page, in the mapping
+    const unsigned char* page(int level, int tx, int ty) const;
+
+private:
+    struct Level
+    {
+        uint32_t width, height;
+        uint64_t offset;
+    };
+
+    const unsigned char *data = NULL;
+    size_t size = 0;
+    uint64_t source_hash = 0;
+    std::vector<Level> table;
+
+    TextureFile() {}
+    TextureFile(const TextureFile&);
+    TextureFile& operator=(const TextureFile&);
+};
+
+#endif
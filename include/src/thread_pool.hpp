@@ -0,0 +1,48 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+//A fixed set of worker threads that lives as long as the render
+//Create one per run and hand it to every frame instead of spawning threads
+//per frame
+
+class ThreadPool
+{
+public:
+    ThreadPool(int);
+    ~ThreadPool();
+
+    //number of threads that run work, including the caller of parallel_for
+    int size() const { return workers.size() + 1; }
+
+    void submit(std::function<void ()>);
+    //blocks until every submitted task has finished
+    void wait();
+
+    //runs body(0) ... body(n - 1), handing out indices one at a time so uneven
+    //work items balance out. The calling thread takes part and the call
+    //returns when every index is done. Don't call it from inside a pool task
+    void parallel_for(int, std::function<void (int)>);
+
+    static int hardware_threads();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void ()> > tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    int active = 0;
+    bool stopping = false;
+
+    void worker_loop();
+};
+
+#endif
@@ -26,7 +26,7 @@
 //and what it may have hit
 //would like to filter by objects hit and pixel starting points
 
-struct RayObjectNode
+struct RayObjectNode : public Tagged<MemoryTag::tracker>
 {
     std::string key; //composed of ray and object id
     //why ref and pointer?
@@ -0,0 +1,37 @@
+#include <vector>
+#include "objects.h"
+#include "ray.h"
+
+#ifndef UNBOUNDED_HPP
+#define UNBOUNDED_HPP
+
+//Scene objects without a finite bounding box
+//A plane or an ambient light in the BVH gives every node on its path an
+//infinite box, so every ray would enter them. They are kept here instead
+//and tested before the BVH. A ground plane hit found first also
+//shortens the interval the BVH traversal has to cover.
+//Planes are stored as structure of arrays so the test is one flat loop.
+
+class UnboundedSet
+{
+public:
+    std::vector<Object*> objects; //everything added, in order
+
+    UnboundedSet() {};
+
+    void clear();
+    void add(Object*);
+    bool empty() const { return objects.empty(); }
+
+    //same contract as Object::intersects with the interval [tmin, closest.t)
+    //returns true if closest was replaced
+    bool intersect(const Ray&, float tmin, HitRecord &closest) const;
+
+private:
+    std::vector<float> nx, ny, nz, d; //plane normals and offsets
+    std::vector<Object*> planes;
+    std::vector<Object*> ambient; //always hit, as far away as possible
+    std::vector<Object*> others; //anything else without bounds, tested one by one
+};
+
+#endif
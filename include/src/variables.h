@@ -31,7 +31,8 @@ enum class ObjType
     plane,
     triangle,
     box,
-    light
+    light,
+    instance
 };
 
 enum class LightType
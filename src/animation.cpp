@@ -0,0 +1,67 @@
+#include "src/animation.hpp"
+
+Keyframe::Keyframe(float t, vec3 tr, quat rot, vec3 sc) {
+    time = t;
+    translation = tr;
+    rotation = rot;
+    scale = sc;
+}
+
+//static
+quat Keyframe::axis_angle(const float degrees, const vec3& axis) {
+    return glm::angleAxis(Transform::degToRad(degrees), glm::normalize(axis));
+}
+
+mat4 Keyframe::to_matrix() const {
+    return Transform::translate(translation.x, translation.y, translation.z) *
+        glm::mat4_cast(rotation) *
+        Transform::scale(scale.x, scale.y, scale.z);
+}
+
+AnimationTrack::AnimationTrack(Object *o) {
+    obj = o;
+}
+
+void AnimationTrack::add_key(const Keyframe &key) {
+    std::vector<Keyframe>::iterator it = keys.begin();
+    while (it != keys.end() && it->time <= key.time) ++it;
+    keys.insert(it, key);
+}
+
+mat4 AnimationTrack::evaluate(float t) const {
+    if (keys.empty()) return obj->objectToWorld;
+    if (t <= keys.front().time) return keys.front().to_matrix();
+    if (t >= keys.back().time) return keys.back().to_matrix();
+
+    unsigned int k = 1;
+    while (keys[k].time < t) k++;
+    const Keyframe &a = keys[k - 1];
+    const Keyframe &b = keys[k];
+    float s = (t - a.time) / (b.time - a.time);
+
+    Keyframe pose = Keyframe(t,
+        glm::mix(a.translation, b.translation, s),
+        glm::slerp(a.rotation, b.rotation, s),
+        glm::mix(a.scale, b.scale, s));
+    return pose.to_matrix();
+}
+
+AnimationTrack& Animation::track(Object *obj) {
+    for (unsigned int i = 0; i < tracks.size(); i++) {
+        if (tracks[i].obj == obj) return tracks[i];
+    }
+    tracks.push_back(AnimationTrack(obj));
+    return tracks.back();
+}
+
+bool Animation::apply(float t) {
+    bool moved = false;
+    for (unsigned int i = 0; i < tracks.size(); i++) {
+        mat4 otw = tracks[i].evaluate(t);
+        if (otw != tracks[i].obj->objectToWorld) {
+            tracks[i].obj->set_transform(otw);
+            moved = true;
+        }
+    }
+    return moved;
+}
@@ -0,0 +1,104 @@
+#include "src/bvh.hpp"
+#include <algorithm>
+
+void BVH::build(const std::vector<Object*> &objects) {
+    prims = objects;
+    nodes.clear();
+    if (prims.empty()) return;
+
+    nodes.reserve(2 * prims.size());
+    std::vector<vec3> centroids(prims.size());
+    for (unsigned int i = 0; i < prims.size(); i++) {
+        //an infinite box has a zero centroid, which is as good as any
+        centroids[i] = prims[i]->get_bounds().center();
+    }
+    build_recursive(0, prims.size(), centroids);
+}
+
+bool BVH::cull(const Frustum &frustum, std::vector<Object*> &out, unsigned int max) const {
+    out.clear();
+    if (nodes.empty()) return true;
+
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int index = stack[--top];
+        const Node &node = nodes[index];
+        if (!frustum.overlaps(node.box)) continue;
+
+        if (node.count > 0) {
+            if (out.size() + node.count > max) return false;
+            out.insert(out.end(), prims.begin() + node.first, prims.begin() + node.first + node.count);
+        }
+        else {
+            stack[top++] = node.right;
+            stack[top++] = index + 1;
+        }
+    }
+    return true;
+}
+
+int BVH::build_recursive(int first, int count, std::vector<vec3> &centroids) {
+    int index = nodes.size();
+    nodes.push_back(Node());
+
+    AABB box, centroid_box;
+    for (int i = first; i < first + count; i++) {
+        box.extend(prims[i]->get_bounds());
+        centroid_box.extend(centroids[i]);
+    }
+    nodes[index].box = box;
+
+    if (count <= LEAF_SIZE) {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        nodes[index].right = -1;
+        return index;
+    }
+
+    //median split along the widest centroid axis
+    vec3 extent = centroid_box.max - centroid_box.min;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = first + i;
+    int mid = count / 2;
+    std::nth_element(order.begin(), order.begin() + mid, order.end(),
+        [&centroids, axis](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    std::vector<Object*> sorted_prims(count);
+    std::vector<vec3> sorted_centroids(count);
+    for (int i = 0; i < count; i++) {
+        sorted_prims[i] = prims[order[i]];
+        sorted_centroids[i] = centroids[order[i]];
+    }
+    std::copy(sorted_prims.begin(), sorted_prims.end(), prims.begin() + first);
+    std::copy(sorted_centroids.begin(), sorted_centroids.end(), centroids.begin() + first);
+
+    nodes[index].first = first;
+    nodes[index].count = 0;
+    build_recursive(first, mid, centroids);
+    int right = build_recursive(first + mid, count - mid, centroids);
+    nodes[index].right = right;
+    return index;
+}
+
+void BVH::refit() {
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        Node &node = nodes[i];
+        AABB box;
+        if (node.count > 0) {
+            for (int p = node.first; p < node.first + node.count; p++) {
+                box.extend(prims[p]->get_bounds());
+            }
+        }
+        else {
+            box.extend(nodes[i + 1].box);
+            box.extend(nodes[node.right].box);
+        }
+        node.box = box;
+    }
+}
@@ -0,0 +1,168 @@
+#include "src/denoise.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//B3 spline, the kernel is its outer product
+static const float KERNEL[5] = {1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+static const int ROWS_PER_TASK = 8;
+
+void GuideBuffers::resize(int w, int h) {
+    width = w;
+    height = h;
+    normal.assign(w * h, vec3(0.0));
+    albedo.assign(w * h, vec3(0.0));
+    depth.assign(w * h, -1.0);
+}
+
+//exp(-e) for e >= 0 to about 1e-5, straight line code so tap loops vectorize
+//(expf is a library call the compiler won't turn into SIMD)
+static inline float _exp_neg(float e) {
+    float t = -e * 1.44269504f; //as a power of 2
+    int i = (int)t; //towards 0, leaves f in (-1, 0]
+    float f = t - i;
+    float p = 1.0f + f * (0.69314718f + f * (0.24022651f + f * (0.05550411f + f * (0.00961813f + f * 0.00133336f))));
+    //underflow to 0 on the integer side, a float clamp would stop the
+    //loops from vectorizing
+    int32_t bits = i < -126 ? 0 : (i + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+//planes and weights for one pass, passed by value so the compiler keeps the
+//pointers in registers across the tap loops
+struct _TapInputs
+{
+    const float *r, *g, *b;
+    const float *nx, *ny, *nz;
+    const float *ar, *ag, *ab;
+    const float *depth;
+    float inv_color, inv_normal, inv_albedo, inv_depth;
+};
+
+//one tap of pixel p against pixel q, added to the running sums
+static inline void _tap(const _TapInputs in, int p, int q, float k, float &sr, float &sg, float &sb, float &total)
+{
+    float dr = in.r[q] - in.r[p];
+    float dg = in.g[q] - in.g[p];
+    float db = in.b[q] - in.b[p];
+    float ar = in.ar[q] - in.ar[p];
+    float ag = in.ag[q] - in.ag[p];
+    float ab = in.ab[q] - in.ab[p];
+    float cos_n = in.nx[p] * in.nx[q] + in.ny[p] * in.ny[q] + in.nz[p] * in.nz[q];
+    float e = (dr * dr + dg * dg + db * db) * in.inv_color
+        + (ar * ar + ag * ag + ab * ab) * in.inv_albedo
+        + (1.0f - cos_n) * in.inv_normal
+        + fabsf(in.depth[q] - in.depth[p]) * in.inv_depth;
+    //hits and misses never mix, multiplied in rather than branched on
+    float same = (float)((in.depth[p] < 0.0f) == (in.depth[q] < 0.0f));
+    float w = same * k * _exp_neg(e);
+    sr += w * in.r[q];
+    sg += w * in.g[q];
+    sb += w * in.b[q];
+    total += w;
+}
+
+void Denoiser::filter_rows(const Planes &in, float *const dst[3], int step, float inv_color, int y0, int y1) const {
+    int width = in.width;
+    int height = in.height;
+    _TapInputs taps;
+    taps.r = in.color[0];
+    taps.g = in.color[1];
+    taps.b = in.color[2];
+    taps.nx = in.normal[0];
+    taps.ny = in.normal[1];
+    taps.nz = in.normal[2];
+    taps.ar = in.albedo[0];
+    taps.ag = in.albedo[1];
+    taps.ab = in.albedo[2];
+    taps.depth = in.depth;
+    taps.inv_color = inv_color;
+    taps.inv_normal = 1.0 / sigma_normal;
+    taps.inv_albedo = 1.0 / (sigma_albedo * sigma_albedo);
+    taps.inv_depth = 1.0 / (sigma_depth * step);
+
+    //sums for one row, filled tap by tap so the inner loop runs along x
+    std::vector<float> sums(4 * width);
+    float *sr = &sums[0], *sg = sr + width, *sb = sg + width, *total = sb + width;
+
+    for (int y = y0; y < y1; y++) {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        int row = y * width;
+        for (int j = -2; j <= 2; j++) {
+            //clamp to the border, the edge pixels repeat
+            int qy = std::min(std::max(y + j * step, 0), height - 1);
+            int qrow = qy * width;
+            for (int i = -2; i <= 2; i++) {
+                float k = KERNEL[i + 2] * KERNEL[j + 2];
+                int dx = i * step;
+                //taps that stay inside the row are a fixed offset away
+                int x0 = std::min(std::max(-dx, 0), width);
+                int x1 = std::max(std::min(width - dx, width), x0);
+                for (int x = 0; x < x0; x++) {
+                    _tap(taps, row + x, qrow + std::min(std::max(x + dx, 0), width - 1), k, sr[x], sg[x], sb[x], total[x]);
+                }
+                for (int x = x0; x < x1; x++) {
+                    _tap(taps, row + x, qrow + x + dx, k, sr[x], sg[x], sb[x], total[x]);
+                }
+                for (int x = x1; x < width; x++) {
+                    _tap(taps, row + x, qrow + std::min(std::max(x + dx, 0), width - 1), k, sr[x], sg[x], sb[x], total[x]);
+                }
+            }
+        }
+        //the centre tap always has weight, total is never 0
+        for (int x = 0; x < width; x++) {
+            dst[0][row + x] = sr[x] / total[x];
+            dst[1][row + x] = sg[x] / total[x];
+            dst[2][row + x] = sb[x] / total[x];
+        }
+    }
+}
+
+void Denoiser::run(std::vector<vec3> &rgb, const GuideBuffers &guides, ThreadPool &pool) const {
+    int n = guides.width * guides.height;
+    if (n == 0 || (int)rgb.size() != n) return;
+
+    //colour ping-pongs between two sets of planes, the guides stay put
+    std::vector<float> a(3 * n), b(3 * n), guide(6 * n);
+    for (int p = 0; p < n; p++) {
+        for (int c = 0; c < 3; c++) {
+            a[c * n + p] = rgb[p][c];
+            guide[c * n + p] = guides.normal[p][c];
+            guide[(3 + c) * n + p] = guides.albedo[p][c];
+        }
+    }
+
+    Planes in;
+    in.width = guides.width;
+    in.height = guides.height;
+    for (int c = 0; c < 3; c++) {
+        in.normal[c] = &guide[c * n];
+        in.albedo[c] = &guide[(3 + c) * n];
+    }
+    in.depth = &guides.depth[0];
+
+    float *src = &a[0], *dst = &b[0];
+    int tasks = (guides.height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    float sigma = sigma_color;
+    for (int pass = 0; pass < passes; pass++) {
+        for (int c = 0; c < 3; c++) {
+            in.color[c] = src + c * n;
+        }
+        float *const out[3] = {dst, dst + n, dst + 2 * n};
+        int step = 1 << pass;
+        float inv_color = 1.0 / (sigma * sigma);
+        pool.parallel_for(tasks, [&](int t) {
+            int y0 = t * ROWS_PER_TASK;
+            filter_rows(in, out, step, inv_color, y0, std::min(y0 + ROWS_PER_TASK, guides.height));
+        });
+        std::swap(src, dst);
+        sigma *= 0.5;
+    }
+
+    for (int p = 0; p < n; p++) {
+        rgb[p] = vec3(src[p], src[n + p], src[2 * n + p]);
+    }
+}
@@ -0,0 +1,278 @@
+#include "src/distributed.hpp"
+#include <algorithm>
+#include <deque>
+#include <cstdio>
+#include <ctime>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+//static member definition
+int TileCoordinator::worker_index = -1;
+
+//messages are plain int32 arrays
+//request:  tile index, x0, y0, x1, y1 (tile index -1 asks the worker to exit)
+//response: tile index, pixel count, then pixel count rgb floats
+static const int REQUEST_INTS = 5;
+static const int RESPONSE_INTS = 2;
+
+static double _now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool _read_full(int fd, void *buf, size_t len) {
+    char *p = (char*)buf;
+    while (len > 0) {
+        ssize_t r = read(fd, p, len);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+static bool _write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char*)buf;
+    while (len > 0) {
+        //MSG_NOSIGNAL so a dead peer shows up as an error instead of SIGPIPE
+        ssize_t r = send(fd, p, len, MSG_NOSIGNAL);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+TileCoordinator::TileCoordinator(int n, double timeout_seconds) {
+    num_workers = n;
+    timeout = timeout_seconds;
+}
+
+//static
+void TileCoordinator::worker_loop(int fd, TileRenderer renderer) {
+    std::vector<vec3> rgb;
+    int32_t request[REQUEST_INTS];
+    while (_read_full(fd, request, sizeof(request)) && request[0] >= 0) {
+        Tile tile;
+        tile.x0 = request[1];
+        tile.y0 = request[2];
+        tile.x1 = request[3];
+        tile.y1 = request[4];
+        rgb.resize(tile.size());
+        renderer(tile, &rgb[0]);
+
+        int32_t response[RESPONSE_INTS] = {request[0], tile.size()};
+        if (!_write_full(fd, response, sizeof(response)) ||
+            !_write_full(fd, &rgb[0], rgb.size() * sizeof(vec3))) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+void TileCoordinator::spawn(TileRenderer renderer) {
+    //don't let children flush our buffered output a second time
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int i = 0; i < num_workers; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            perror("socketpair");
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            for (unsigned int w = 0; w < workers.size(); w++) {
+                close(workers[w].fd);
+            }
+            worker_index = i;
+            worker_loop(fds[1], renderer);
+            _exit(0);
+        }
+
+        close(fds[1]);
+        if (pid < 0) {
+            perror("fork");
+            close(fds[0]);
+            continue;
+        }
+
+        Worker worker;
+        worker.pid = pid;
+        worker.fd = fds[0];
+        worker.tile = -1;
+        worker.started = 0.0;
+        workers.push_back(worker);
+    }
+}
+
+void TileCoordinator::shutdown() {
+    for (unsigned int w = 0; w < workers.size(); w++) {
+        if (workers[w].tile >= 0) {
+            //still busy on a tile somebody else already finished
+            kill(workers[w].pid, SIGKILL);
+        }
+        else {
+            int32_t request[REQUEST_INTS] = {-1, 0, 0, 0, 0};
+            _write_full(workers[w].fd, request, sizeof(request));
+        }
+        close(workers[w].fd);
+        waitpid(workers[w].pid, NULL, 0);
+    }
+    workers.clear();
+}
+
+void TileCoordinator::render(const std::vector<Tile> &tiles, TileRenderer renderer, TileSink sink) {
+    int remaining = tiles.size();
+    std::vector<bool> done(tiles.size(), false);
+    std::vector<bool> reissue_marked(tiles.size(), false);
+    std::deque<int> pending;
+    for (unsigned int t = 0; t < tiles.size(); t++) {
+        pending.push_back(t);
+    }
+
+    spawn(renderer);
+
+    std::vector<vec3> rgb;
+    std::vector<pollfd> pfds;
+    std::vector<int> polled;
+
+    while (remaining > 0) {
+        std::vector<int> dead;
+
+        //hand out work to idle workers
+        for (unsigned int w = 0; w < workers.size(); w++) {
+            Worker &worker = workers[w];
+            while (worker.tile < 0 && !pending.empty()) {
+                int t = pending.front();
+                pending.pop_front();
+                if (done[t]) continue;
+
+                const Tile &tile = tiles[t];
+                int32_t request[REQUEST_INTS] = {t, tile.x0, tile.y0, tile.x1, tile.y1};
+                if (_write_full(worker.fd, request, sizeof(request))) {
+                    worker.tile = t;
+                    worker.started = _now();
+                }
+                else {
+                    //worker is gone, the tile goes back to the front
+                    pending.push_front(t);
+                    dead.push_back(w);
+                    break;
+                }
+            }
+        }
+
+        //wait for results or for the oldest tile to time out
+        pfds.clear();
+        polled.clear();
+        double wait = -1.0;
+        double now = _now();
+        for (unsigned int w = 0; w < workers.size(); w++) {
+            if (workers[w].tile < 0) continue;
+            pollfd pfd;
+            pfd.fd = workers[w].fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            pfds.push_back(pfd);
+            polled.push_back(w);
+
+            //a duplicate goes out after one timeout, the worker is killed after two
+            double deadline = reissue_marked[workers[w].tile] ? 2.0 * timeout : timeout;
+            double left = workers[w].started + deadline - now;
+            if (left < 0.0) left = 0.0;
+            if (wait < 0.0 || left < wait) wait = left;
+        }
+
+        if (pfds.empty() && dead.size() == workers.size()) {
+            //every worker is dead, finish the frame here
+            while (!pending.empty()) {
+                int t = pending.front();
+                pending.pop_front();
+                if (done[t]) continue;
+                rgb.resize(tiles[t].size());
+                renderer(tiles[t], &rgb[0]);
+                sink(tiles[t], &rgb[0]);
+                done[t] = true;
+                remaining--;
+            }
+        }
+
+        int timeout_ms = (wait < 0.0) ? -1 : (int)(wait * 1000.0) + 1;
+        if (!pfds.empty() && poll(&pfds[0], pfds.size(), timeout_ms) < 0) {
+            continue; //interrupted
+        }
+
+        for (unsigned int p = 0; p < pfds.size(); p++) {
+            if (pfds[p].revents == 0) continue;
+            Worker &worker = workers[polled[p]];
+
+            int32_t response[RESPONSE_INTS];
+            bool ok = _read_full(worker.fd, response, sizeof(response)) &&
+                response[0] == worker.tile &&
+                response[1] == tiles[worker.tile].size();
+            if (ok) {
+                rgb.resize(response[1]);
+                ok = _read_full(worker.fd, &rgb[0], rgb.size() * sizeof(vec3));
+            }
+
+            int t = worker.tile;
+            worker.tile = -1;
+            if (!ok) {
+                dead.push_back(polled[p]);
+                if (!done[t]) {
+                    pending.push_front(t);
+                    reissued++;
+                }
+                continue;
+            }
+
+            if (!done[t]) {
+                sink(tiles[t], &rgb[0]);
+                done[t] = true;
+                remaining--;
+            }
+        }
+
+        //stragglers get a duplicate issued to the next idle worker
+        now = _now();
+        for (unsigned int w = 0; w < workers.size(); w++) {
+            int t = workers[w].tile;
+            if (t >= 0 && !done[t] && !reissue_marked[t] && now - workers[w].started >= timeout) {
+                reissue_marked[t] = true;
+                pending.push_front(t);
+                reissued++;
+            }
+            else if (t >= 0 && now - workers[w].started >= 2.0 * timeout) {
+                //hung, or too slow to be worth waiting for, the tile goes out
+                //again in case its duplicate went to another hung worker
+                dead.push_back(w);
+                workers[w].tile = -1;
+                if (!done[t]) {
+                    pending.push_front(t);
+                }
+            }
+        }
+
+        //drop dead workers, highest index first so the rest stay valid
+        std::sort(dead.begin(), dead.end());
+        for (int d = (int)dead.size() - 1; d >= 0; d--) {
+            Worker &worker = workers[dead[d]];
+            kill(worker.pid, SIGKILL);
+            close(worker.fd);
+            waitpid(worker.pid, NULL, 0);
+            workers.erase(workers.begin() + dead[d]);
+            failed_workers++;
+        }
+    }
+
+    shutdown();
+}
@@ -0,0 +1,126 @@
+#include "src/framebuffer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+StreamingImage::StreamingImage(const std::string &path, int w, int h, int rows, unsigned int bands, bool block) {
+    width = w;
+    height = h;
+    band_rows = rows;
+    max_bands = bands > 0 ? bands : 1;
+    blocking = block;
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path.c_str());
+        return;
+    }
+
+    char header[64];
+    int len = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    header_bytes = len;
+    //size the file now so bands can land anywhere in it
+    if (write(fd, header, len) != len ||
+        ftruncate(fd, header_bytes + (off_t)width * height * 3) != 0) {
+        perror(path.c_str());
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    writer = std::thread(&StreamingImage::writer_loop, this);
+}
+
+StreamingImage::~StreamingImage() {
+    close();
+}
+
+void StreamingImage::write_tile(const Tile &tile, const vec3 *rgb) {
+    if (fd < 0) return;
+    int b = tile.y0 / band_rows;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (blocking) {
+        //another thread may open this band while we wait
+        band_written.wait(lock, [this, b] { return resident.count(b) || resident.size() < max_bands; });
+    }
+    std::map<int, Band*>::iterator it = resident.find(b);
+    if (it == resident.end()) {
+        int rows = std::min(band_rows, height - b * band_rows);
+        Band *band = new Band();
+        band->rgb.resize((size_t)rows * width * 3);
+        band->pixels_left = rows * width;
+        it = resident.insert(std::make_pair(b, band)).first;
+        if (resident.size() > peak_bands) peak_bands = resident.size();
+    }
+    Band *band = it->second;
+    lock.unlock();
+
+    //tiles own disjoint pixels of the band, so the copy needs no lock
+    for (int j = tile.y0; j < tile.y1; j++) {
+        uint8_t *row = &band->rgb[((size_t)(j - b * band_rows) * width + tile.x0) * 3];
+        for (int i = 0; i < tile.width(); i++) {
+            vec3 c = glm::clamp(rgb[(j - tile.y0) * tile.width() + i], 0.0f, 1.0f);
+            row[i * 3] = (uint8_t)(c.r * 255.0);
+            row[i * 3 + 1] = (uint8_t)(c.g * 255.0);
+            row[i * 3 + 2] = (uint8_t)(c.b * 255.0);
+        }
+    }
+
+    lock.lock();
+    band->pixels_left -= tile.size();
+    if (band->pixels_left == 0) {
+        finished.push_back(b);
+        band_finished.notify_one();
+    }
+}
+
+void StreamingImage::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        band_finished.wait(lock, [this] { return stopping || !finished.empty(); });
+        if (finished.empty()) return;
+
+        int b = finished.front();
+        finished.pop_front();
+        Band *band = resident[b];
+        lock.unlock();
+
+        off_t offset = header_bytes + (off_t)b * band_rows * width * 3;
+        size_t done = 0;
+        while (done < band->rgb.size()) {
+            ssize_t w = pwrite(fd, &band->rgb[done], band->rgb.size() - done, offset + done);
+            if (w <= 0) break;
+            done += w;
+        }
+
+        lock.lock();
+        if (done < band->rgb.size()) failed = true;
+        resident.erase(b);
+        delete band;
+        band_written.notify_all();
+    }
+}
+
+bool StreamingImage::close() {
+    if (fd < 0) return false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    band_finished.notify_one();
+    writer.join();
+
+    //anything still resident never got all of its tiles
+    bool complete = resident.empty() && !failed;
+    for (std::map<int, Band*>::iterator it = resident.begin(); it != resident.end(); ++it) {
+        delete it->second;
+    }
+    resident.clear();
+
+    if (::close(fd) != 0) complete = false;
+    fd = -1;
+    return complete;
+}
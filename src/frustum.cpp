@@ -0,0 +1,29 @@
+#include "src/frustum.hpp"
+
+Frustum::Frustum(const vec3 &o, const vec3 corners[4]) {
+    origin = o;
+    vec3 middle = corners[0] + corners[1] + corners[2] + corners[3];
+    for (int i = 0; i < 4; i++) {
+        normals[i] = glm::cross(corners[i], corners[(i + 1) % 4]);
+        //flip so the packet's middle ray is on the inside
+        if (glm::dot(normals[i], middle) < 0.0f) {
+            normals[i] = -normals[i];
+        }
+    }
+}
+
+bool Frustum::overlaps(const AABB &box) const {
+    if (box.is_empty()) return false;
+    if (box.is_infinite()) return true;
+
+    for (int i = 0; i < 4; i++) {
+        const vec3 &n = normals[i];
+        //the corner furthest along the normal decides
+        vec3 p = vec3(
+            n.x >= 0.0f ? box.max.x : box.min.x,
+            n.y >= 0.0f ? box.max.y : box.min.y,
+            n.z >= 0.0f ? box.max.z : box.min.z);
+        if (glm::dot(n, p - origin) < 0.0f) return false;
+    }
+    return true;
+}
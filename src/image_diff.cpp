@@ -0,0 +1,51 @@
+#include "src/image_diff.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+bool PPMImage::read(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL) return false;
+
+    int maxval = 0;
+    //the single whitespace byte after maxval is eaten by the trailing %c
+    char magic[3] = {0, 0, 0}, separator = 0;
+    bool ok = fscanf(f, "%2s %d %d %d%c", magic, &width, &height, &maxval, &separator) == 5 &&
+        magic[0] == 'P' && magic[1] == '6' && maxval == 255 && width > 0 && height > 0;
+    if (ok) {
+        rgb.resize((size_t)width * height * 3);
+        ok = fread(&rgb[0], 1, rgb.size(), f) == rgb.size();
+    }
+    fclose(f);
+    if (!ok) {
+        width = height = 0;
+        rgb.clear();
+    }
+    return ok;
+}
+
+//static
+ImageDiff ImageDiff::compare(const PPMImage &a, const PPMImage &b) {
+    ImageDiff diff;
+    if (a.width != b.width || a.height != b.height || a.rgb.size() != b.rgb.size() || a.rgb.empty()) {
+        diff.max_error = 255;
+        diff.differing = (long)a.width * a.height;
+        return diff;
+    }
+
+    double squared = 0.0;
+    for (size_t p = 0; p < a.rgb.size(); p += 3) {
+        bool off = false;
+        for (int c = 0; c < 3; c++) {
+            int e = abs((int)a.rgb[p + c] - (int)b.rgb[p + c]);
+            squared += (double)e * e;
+            if (e > diff.max_error) diff.max_error = e;
+            if (e > 0) off = true;
+        }
+        if (off) diff.differing++;
+    }
+
+    double mse = squared / a.rgb.size();
+    diff.psnr = (mse == 0.0) ? INFINITY : 10.0 * log10(255.0 * 255.0 / mse);
+    return diff;
+}
@@ -0,0 +1,118 @@
+#include "src/instance.hpp"
+
+Geometry::~Geometry() {
+    for (unsigned int i = 0; i < prims.size(); i++) {
+        delete prims[i];
+    }
+}
+
+void Geometry::add(Object *prim) {
+    prims.push_back(prim);
+}
+
+void Geometry::build() {
+    bvh.build(prims);
+}
+
+AABB Geometry::get_bounds() const {
+    if (bvh.nodes.empty()) return AABB();
+    return bvh.nodes[0].box;
+}
+
+Instance::Instance(const Geometry *geo, mat4 *otw, vec4 col) : Object(otw, col, 1.0, false, "") {
+    type = ObjType::instance;
+    geometry = geo;
+}
+
+bool Instance::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t1) {
+    //world distances are along the normalized world direction
+    vec3 dir = glm::normalize(ray.direction);
+    vec3 local_origin = vec3(worldToObject * vec4(ray.origin, 1.0));
+    vec3 local_dir = vec3(worldToObject * vec4(dir, 0.0));
+
+    //one world unit along the ray is this many object space units
+    float scale = glm::length(local_dir);
+    Ray local_ray = Ray(local_origin, local_dir / scale, ray.type, ray.id);
+
+    float nearest = INFINITY;
+    bool is_hit = false;
+    vec3 local_hit, local_n, prim_hit, prim_n;
+    float local_t1 = 0.0;
+    float d1, d2;
+    geometry->bvh.traverse(local_ray, nearest, [&](Object *prim) {
+        if (prim->intersects(local_ray, prim_hit, prim_n, d1, d2) && d1 < nearest) {
+            nearest = d1;
+            local_t1 = d2;
+            local_hit = prim_hit;
+            local_n = prim_n;
+            is_hit = true;
+        }
+    });
+    if (!is_hit) return false;
+
+    t0 = nearest / scale;
+    t1 = local_t1 / scale;
+    hit = vec3(objectToWorld * vec4(local_hit, 1.0));
+    //normals go through the inverse transpose
+    n = glm::normalize(glm::transpose(mat3(worldToObject)) * local_n);
+    return true;
+}
+
+bool Instance::intersects (const Ray &ray, float tmin, float tmax, float &t, int &prim) {
+    vec3 dir = glm::normalize(ray.direction);
+    vec3 local_origin = vec3(worldToObject * vec4(ray.origin, 1.0));
+    vec3 local_dir = vec3(worldToObject * vec4(dir, 0.0));
+    float scale = glm::length(local_dir);
+    Ray local_ray = Ray(local_origin, local_dir / scale, ray.type, ray.id);
+
+    //the interval is in world units, scale it into object space
+    float local_min = tmin * scale;
+    float nearest = tmax * scale;
+    bool is_hit = false;
+    const std::vector<Object*> &prims = geometry->bvh.prims;
+    geometry->bvh.traverse(local_ray, nearest, [&](Object *const &p) {
+        float prim_t;
+        int sub;
+        if (p->intersects(local_ray, local_min, nearest, prim_t, sub)) {
+            nearest = prim_t;
+            prim = &p - &prims[0];
+            is_hit = true;
+        }
+    });
+    if (!is_hit) return false;
+
+    t = nearest / scale;
+    return true;
+}
+
+void Instance::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+    vec3 dir = glm::normalize(ray.direction);
+    vec3 local_origin = vec3(worldToObject * vec4(ray.origin, 1.0));
+    vec3 local_dir = vec3(worldToObject * vec4(dir, 0.0));
+    float scale = glm::length(local_dir);
+    Ray local_ray = Ray(local_origin, local_dir / scale, ray.type, ray.id);
+
+    HitRecord local;
+    local.t = rec.t * scale;
+    local.object = geometry->bvh.prims[rec.prim];
+    local.object->compute_surface_interaction(local_ray, local, si);
+
+    si.position = vec3(objectToWorld * vec4(si.position, 1.0));
+    //normals go through the inverse transpose
+    si.n = glm::normalize(glm::transpose(mat3(worldToObject)) * si.n);
+}
+
+AABB Instance::get_bounds () {
+    AABB local = geometry->get_bounds();
+    AABB box;
+    if (local.is_empty()) return box;
+    if (local.is_infinite()) return AABB::infinite();
+    for (int c = 0; c < 8; c++) {
+        vec3 corner = vec3(
+            (c & 1) ? local.max.x : local.min.x,
+            (c & 2) ? local.max.y : local.min.y,
+            (c & 4) ? local.max.z : local.min.z);
+        box.extend(vec3(objectToWorld * vec4(corner, 1.0)));
+    }
+    return box;
+}
@@ -0,0 +1,168 @@
+#include "src/irradiance_cache.hpp"
+#include <algorithm>
+#include <cmath>
+
+static const float PI = M_PI;
+
+IrradianceCache::IrradianceCache(float a, float r_min, float r_max) : count(0) {
+    error = a;
+    min_radius = r_min;
+    max_radius = r_max;
+    //a record is trusted out to error * radius
+    cell_size = 2.0 * error * max_radius;
+}
+
+uint64_t IrradianceCache::cell_key(int x, int y, int z) const {
+    const uint64_t mask = (1 << 21) - 1;
+    return (((uint64_t)x & mask) << 42) | (((uint64_t)y & mask) << 21) | ((uint64_t)z & mask);
+}
+
+IrradianceCache::Shard& IrradianceCache::shard_for(uint64_t key) const {
+    //mix the coordinates before picking a shard, neighbours differ in low bits
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    return shards[(h >> 32) % SHARDS];
+}
+
+void IrradianceCache::cell_of(const vec3 &p, int &x, int &y, int &z) const {
+    x = (int)floor(p.x / cell_size);
+    y = (int)floor(p.y / cell_size);
+    z = (int)floor(p.z / cell_size);
+}
+
+bool IrradianceCache::lookup(const vec3 &p, const vec3 &n, vec3 &irradiance) const {
+    int x, y, z;
+    cell_of(p, x, y, z);
+    uint64_t key = cell_key(x, y, z);
+    Shard &shard = shard_for(key);
+
+    vec3 sum = vec3(0.0);
+    float total = 0.0;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, std::vector<IrradianceRecord> >::const_iterator cell = shard.cells.find(key);
+    if (cell == shard.cells.end()) return false;
+
+    for (unsigned int i = 0; i < cell->second.size(); i++) {
+        const IrradianceRecord &rec = cell->second[i];
+        vec3 d = p - rec.position;
+        //records in front of the point saw occluders the point can't
+        if (glm::dot(d, (n + rec.n) * 0.5f) < -0.05 * rec.radius) continue;
+
+        float tilt = 1.0 - glm::dot(n, rec.n);
+        float e = glm::length(d) / rec.radius + sqrt(std::max(tilt, 0.0f));
+        if (e >= error) continue;
+
+        float w = 1.0 / std::max(e, 1e-6f);
+        vec3 rotated = glm::cross(rec.n, n);
+        vec3 estimate;
+        for (int c = 0; c < 3; c++) {
+            estimate[c] = rec.irradiance[c] + glm::dot(rotated, rec.grad_r[c]) + glm::dot(d, rec.grad_t[c]);
+        }
+        sum += w * glm::max(estimate, vec3(0.0));
+        total += w;
+    }
+    if (total <= 0.0) return false;
+    irradiance = sum / total;
+    return true;
+}
+
+void IrradianceCache::insert(const IrradianceRecord &rec) {
+    //every cell the influence sphere touches gets a copy
+    float reach = error * rec.radius;
+    int x0, y0, z0, x1, y1, z1;
+    cell_of(rec.position - vec3(reach), x0, y0, z0);
+    cell_of(rec.position + vec3(reach), x1, y1, z1);
+    for (int x = x0; x <= x1; x++) {
+        for (int y = y0; y <= y1; y++) {
+            for (int z = z0; z <= z1; z++) {
+                uint64_t key = cell_key(x, y, z);
+                Shard &shard = shard_for(key);
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.cells[key].push_back(rec);
+            }
+        }
+    }
+    count++;
+}
+
+void IrradianceCache::clear() {
+    for (int s = 0; s < SHARDS; s++) {
+        std::lock_guard<std::mutex> lock(shards[s].mutex);
+        shards[s].cells.clear();
+    }
+    count = 0;
+}
+
+IrradianceRecord IrradianceCache::sample(const vec3 &p, const vec3 &n, int M, int N, RandomStream &rs, const RadianceFn &trace) const {
+    //tangent frame around n
+    vec3 helper = fabs(n.x) > 0.9 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tu = glm::normalize(glm::cross(helper, n));
+    vec3 tv = glm::cross(n, tu);
+
+    //radiance, distance and polar angle per stratum, row j (theta) major
+    std::vector<vec3> L(M * N);
+    std::vector<float> R(M * N);
+    std::vector<float> theta(M * N);
+    float inv_distance_sum = 0.0;
+    vec3 sum = vec3(0.0);
+    for (int j = 0; j < M; j++) {
+        for (int k = 0; k < N; k++) {
+            //uniform in sin^2 theta is cosine weighted
+            float sin_theta = sqrt((j + rs.next_float()) / M);
+            float cos_theta = sqrt(std::max(0.0f, 1.0f - sin_theta * sin_theta));
+            float phi = 2.0 * PI * (k + rs.next_float()) / N;
+            vec3 dir = sin_theta * (std::cos(phi) * tu + std::sin(phi) * tv) + cos_theta * n;
+
+            int s = j * N + k;
+            R[s] = trace(p, dir, L[s]);
+            theta[s] = asin(sin_theta);
+            if (R[s] < INFINITY) inv_distance_sum += 1.0 / R[s];
+            sum += L[s];
+        }
+    }
+
+    IrradianceRecord rec;
+    rec.position = p;
+    rec.n = n;
+    rec.irradiance = sum * (float)(PI / (M * N));
+    float harmonic = inv_distance_sum > 0.0 ? (M * N) / inv_distance_sum : max_radius;
+    rec.radius = std::min(std::max(harmonic, min_radius), max_radius);
+
+    for (int c = 0; c < 3; c++) {
+        rec.grad_t[c] = vec3(0.0);
+        rec.grad_r[c] = vec3(0.0);
+    }
+    for (int k = 0; k < N; k++) {
+        float phi = 2.0 * PI * (k + 0.5) / N;
+        float phi_minus = 2.0 * PI * k / N;
+        vec3 u_k = std::cos(phi) * tu + std::sin(phi) * tv;
+        vec3 v_k = -std::sin(phi) * tu + std::cos(phi) * tv;
+        vec3 v_minus = -std::sin(phi_minus) * tu + std::cos(phi_minus) * tv;
+        int k_prev = (k + N - 1) % N;
+
+        for (int j = 0; j < M; j++) {
+            int s = j * N + k;
+            float sin_minus = sqrt((float)j / M);
+            float sin_plus = sqrt((float)(j + 1) / M);
+
+            //change across the theta boundary between rows j - 1 and j
+            if (j > 0) {
+                int up = (j - 1) * N + k;
+                float r = std::min(R[s], R[up]);
+                float cos2 = 1.0 - sin_minus * sin_minus;
+                float weight = r < INFINITY ? (2.0 * PI / N) * sin_minus * cos2 / r : 0.0;
+                for (int c = 0; c < 3; c++) {
+                    rec.grad_t[c] += u_k * (weight * (L[s][c] - L[up][c]));
+                }
+            }
+            //change across the phi boundary between columns k - 1 and k
+            int side = j * N + k_prev;
+            float r = std::min(R[s], R[side]);
+            float weight = r < INFINITY ? (sin_plus - sin_minus) / r : 0.0;
+            for (int c = 0; c < 3; c++) {
+                rec.grad_t[c] += v_minus * (weight * (L[s][c] - L[side][c]));
+                rec.grad_r[c] += v_k * (float)(-tan(theta[s]) * L[s][c] * PI / (M * N));
+            }
+        }
+    }
+    return rec;
+}
@@ -0,0 +1,493 @@
+#include "src/kernel_check.hpp"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//how many of a case's values each kind uses
+static const int KIND_VALUES[KernelCheck::KIND_COUNT] = {12, 12, 17, 3};
+
+static float _uniform(RandomStream &rs, float lo, float hi) {
+    return lo + (hi - lo) * rs.next_float();
+}
+
+static vec3 _point(RandomStream &rs, float extent) {
+    return vec3(_uniform(rs, -extent, extent), _uniform(rs, -extent, extent), _uniform(rs, -extent, extent));
+}
+
+static vec3 _unit(RandomStream &rs) {
+    vec3 d;
+    do {
+        d = _point(rs, 1.0f);
+    } while (glm::dot(d, d) < 0.0001f || glm::dot(d, d) > 1.0f);
+    return glm::normalize(d);
+}
+
+static vec3 _perpendicular(RandomStream &rs, const vec3 &d) {
+    vec3 p;
+    do {
+        p = glm::cross(d, _unit(rs));
+    } while (glm::dot(p, p) < 0.0001f);
+    return glm::normalize(p);
+}
+
+//tiny relative offsets either side of an exact boundary
+static float _nudge(RandomStream &rs) {
+    static const float NUDGES[] = {0.0f, 1e-7f, -1e-7f, 1e-5f, -1e-5f, 1e-3f, -1e-3f};
+    return NUDGES[(int)(rs.next_float() * 7) % 7];
+}
+
+static void _set(float *v, const vec3 &p) {
+    v[0] = p.x;
+    v[1] = p.y;
+    v[2] = p.z;
+}
+
+static vec3 _get(const float *v) {
+    return vec3(v[0], v[1], v[2]);
+}
+
+//builds the case's primitive on the stack and hands it to f with the ray
+template <typename F>
+static void _with_object(const KernelCheck::Case &c, F f) {
+    static mat4 identity = mat4(1.0);
+    Ray ray = Ray(_get(c.v), _get(c.v + 3), RayType::camera, 0);
+    if (c.kind == KernelCheck::SPHERE) {
+        Sphere sphere(c.v[11], &identity, vec4(1.0), 1.0);
+        sphere.center = vec4(_get(c.v + 8), 1.0);
+        f(&sphere, ray);
+    }
+    else if (c.kind == KernelCheck::PLANE) {
+        Plane plane(_get(c.v + 8), c.v[11], vec4(1.0), 1.0);
+        f(&plane, ray);
+    }
+    else if (c.kind == KernelCheck::TRIANGLE) {
+        Triangle triangle(_get(c.v + 8), _get(c.v + 11), _get(c.v + 14), vec4(1.0));
+        f(&triangle, ray);
+    }
+}
+
+//significant mantissa bits, -1 for zero, so shrinking always makes progress
+static int _precision(float x) {
+    if (x == 0.0f) return -1;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    uint32_t mantissa = bits & 0x007fffff;
+    int bits_used = 23;
+    while (bits_used > 0 && (mantissa & 1) == 0) {
+        mantissa >>= 1;
+        bits_used--;
+    }
+    return bits_used;
+}
+
+static float _truncate(float x, int keep) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits &= ~((1u << (23 - keep)) - 1);
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+KernelCheck::KernelCheck(uint32_t s, uint32_t tolerance_ulps, float tolerance_absolute) {
+    seed = s;
+    tolerance = tolerance_ulps;
+    absolute = tolerance_absolute;
+}
+
+void KernelCheck::add(Kind kind, const std::string &name, Intersector intersect) {
+    Entry entry;
+    entry.name = name;
+    entry.kind = kind;
+    entry.intersect = intersect;
+    kernels.push_back(entry);
+}
+
+void KernelCheck::add_quadratic(const std::string &name, QuadraticSolver solve) {
+    Entry entry;
+    entry.name = name;
+    entry.kind = QUADRATIC;
+    entry.solve = solve;
+    kernels.push_back(entry);
+}
+
+void KernelCheck::add_builtin() {
+    //the closest hit queries with their early outs, as traversal calls them
+    Intersector query = [](Object *obj, const Ray &ray, float tmin, float tmax, float &t) {
+        int prim;
+        return obj->intersects(ray, tmin, tmax, t, prim);
+    };
+    add(SPHERE, "sphere.closest_hit", query);
+    add(PLANE, "plane.closest_hit", query);
+    add(TRIANGLE, "triangle.closest_hit", query);
+}
+
+//static
+uint32_t KernelCheck::ulp_distance(float a, float b) {
+    if (std::isnan(a) || std::isnan(b)) {
+        return (std::isnan(a) && std::isnan(b)) ? 0 : UINT32_MAX;
+    }
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    //negative floats count down from -0, which lands on +0
+    int64_t oa = ia < 0 ? (int64_t)INT32_MIN - ia : ia;
+    int64_t ob = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+    int64_t d = oa > ob ? oa - ob : ob - oa;
+    return d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+}
+
+//static
+const char* KernelCheck::name(Kind kind) {
+    static const char *names[KIND_COUNT] = {"sphere", "plane", "triangle", "quadratic"};
+    return names[kind];
+}
+
+KernelCheck::Result KernelCheck::reference(const Case &c) const {
+    Result result = unwindowed(c);
+    //the variants only answer for the window
+    if (c.kind != QUADRATIC && !(result.t0 >= c.v[6] && result.t0 < c.v[7])) {
+        result.hit = false;
+    }
+    return result;
+}
+
+KernelCheck::Result KernelCheck::unwindowed(const Case &c) const {
+    Result result;
+    if (c.kind == QUADRATIC) {
+        result.hit = Transform::solve_quadratic(c.v[0], c.v[1], c.v[2], result.t0, result.t1);
+        return result;
+    }
+    _with_object(c, [&](Object *obj, const Ray &ray) {
+        vec3 hit, n;
+        result.hit = obj->intersects(ray, hit, n, result.t0, result.t1);
+    });
+    return result;
+}
+
+const KernelCheck::Entry* KernelCheck::find(const std::string &name) const {
+    for (unsigned int k = 0; k < kernels.size(); k++) {
+        if (kernels[k].name == name) return &kernels[k];
+    }
+    return NULL;
+}
+
+KernelCheck::Result KernelCheck::evaluate(const std::string &name, const Case &c) const {
+    const Entry *entry = find(name);
+    return entry != NULL ? run_entry(*entry, c) : Result();
+}
+
+KernelCheck::Result KernelCheck::run_entry(const Entry &entry, const Case &c) const {
+    Result result;
+    if (entry.kind == QUADRATIC) {
+        result.hit = entry.solve(c.v[0], c.v[1], c.v[2], result.t0, result.t1);
+        return result;
+    }
+    _with_object(c, [&](Object *obj, const Ray &ray) {
+        float t = 0.0f;
+        result.hit = entry.intersect(obj, ray, c.v[6], c.v[7], t);
+        if (result.hit) result.t0 = t;
+    });
+    return result;
+}
+
+bool KernelCheck::near_edge(float t, float edge) const {
+    return t != edge && (ulp_distance(t, edge) <= tolerance || fabs(t - edge) <= absolute);
+}
+
+bool KernelCheck::disagrees(const Entry &entry, const Case &c, uint32_t &ulps) const {
+    Result expected = reference(c);
+    Result actual = run_entry(entry, c);
+    ulps = 0;
+    if (expected.hit != actual.hit) {
+        //a t within tolerance of the window's edge may land on either side
+        //(one exactly on it, like the t = 0 of an origin inside a sphere, may not)
+        Result raw = unwindowed(c);
+        if (c.kind != QUADRATIC && raw.hit && (near_edge(raw.t0, c.v[6]) || near_edge(raw.t0, c.v[7]))) {
+            return false;
+        }
+        ulps = UINT32_MAX;
+        return true;
+    }
+    if (!expected.hit) return false;
+    ulps = ulp_distance(expected.t0, actual.t0);
+    bool close = fabs(expected.t0 - actual.t0) <= absolute;
+    if (c.kind == QUADRATIC) {
+        uint32_t second = ulp_distance(expected.t1, actual.t1);
+        if (second > ulps) ulps = second;
+        close = close && fabs(expected.t1 - actual.t1) <= absolute;
+    }
+    return ulps > tolerance && !close;
+}
+
+//which side hit and which t is NaN, a shrunk case has to fail the same way
+static int _signature(const KernelCheck::Result &expected, const KernelCheck::Result &actual) {
+    return expected.hit | actual.hit << 1 | std::isnan(expected.t0) << 2 | std::isnan(actual.t0) << 3;
+}
+
+KernelCheck::Case KernelCheck::shrink(const Entry &entry, const Case &failing) const {
+    Case c = failing;
+    int signature = _signature(reference(c), run_entry(entry, c));
+    uint32_t ulps;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < KIND_VALUES[c.kind]; i++) {
+            float x = c.v[i];
+            float candidates[] = {0.0f, std::trunc(x), std::round(x * 16.0f) / 16.0f,
+                _truncate(x, 4), _truncate(x, 8), _truncate(x, 12), _truncate(x, 16)};
+            for (unsigned int k = 0; k < sizeof(candidates) / sizeof(candidates[0]); k++) {
+                if (_precision(candidates[k]) >= _precision(x)) continue;
+                c.v[i] = candidates[k];
+                if (disagrees(entry, c, ulps) && _signature(reference(c), run_entry(entry, c)) == signature) {
+                    changed = true;
+                    break;
+                }
+                c.v[i] = x;
+            }
+        }
+    }
+    return c;
+}
+
+//static
+KernelCheck::Case KernelCheck::generate(Kind kind, RandomStream &rs, bool adversarial) {
+    Case c;
+    c.kind = kind;
+    memset(c.v, 0, sizeof(c.v));
+    int pick = (int)(rs.next_float() * 4);
+
+    if (kind == QUADRATIC) {
+        float a = _uniform(rs, -100.0f, 100.0f);
+        float b = _uniform(rs, -100.0f, 100.0f);
+        float cc = _uniform(rs, -100.0f, 100.0f);
+        if (adversarial) {
+            float r = _uniform(rs, -10.0f, 10.0f);
+            if (pick == 0) {
+                //a double root, the discriminant lands around zero
+                b = -2.0f * a * r * (1.0f + _nudge(rs));
+                cc = a * r * r;
+            }
+            else if (pick == 1) {
+                //b dwarfs a and c, the naive formula cancels
+                b = _uniform(rs, 1e3f, 1e5f) * (rs.next_float() < 0.5f ? -1.0f : 1.0f);
+                a = _uniform(rs, 1e-3f, 1.0f);
+                cc = _uniform(rs, -1.0f, 1.0f);
+            }
+            else if (pick == 2) {
+                cc = 0.0f;
+            }
+            else {
+                a = _uniform(rs, -1e-6f, 1e-6f);
+            }
+        }
+        c.v[0] = a;
+        c.v[1] = b;
+        c.v[2] = cc;
+        return c;
+    }
+
+    vec3 origin = _point(rs, 20.0f);
+    vec3 dir = _unit(rs);
+    c.v[6] = 0.0f;
+    c.v[7] = FLT_MAX;
+    if (rs.next_float() < 0.25f) {
+        //a narrowed window, as after an earlier hit
+        c.v[6] = 0.001f;
+        c.v[7] = _uniform(rs, 0.0f, 40.0f);
+    }
+
+    if (kind == SPHERE) {
+        vec3 center = _point(rs, 10.0f);
+        float radius = _uniform(rs, 0.01f, 5.0f);
+        if (adversarial) {
+            if (pick == 0) {
+                //grazing, aimed just inside or outside the silhouette
+                vec3 side = _perpendicular(rs, dir);
+                origin = center + side * radius * (1.0f + _nudge(rs)) - dir * _uniform(rs, 0.5f, 50.0f);
+            }
+            else if (pick == 1) {
+                origin = center + _unit(rs) * radius * rs.next_float();
+            }
+            else if (pick == 2) {
+                //on the surface
+                origin = center + _unit(rs) * radius;
+            }
+            else {
+                //centre right beside the origin, t_ca around zero
+                origin = center + _perpendicular(rs, dir) * radius * _uniform(rs, 0.5f, 2.0f) + dir * radius * _nudge(rs);
+            }
+        }
+        else if (pick < 2) {
+            //half the random rays head for the sphere so hits get compared too
+            dir = glm::normalize(center + _point(rs, radius) - origin);
+        }
+        _set(c.v + 8, center);
+        c.v[11] = radius;
+    }
+    else if (kind == PLANE) {
+        vec3 n = (rs.next_float() < 0.5f) ? _unit(rs) : vec3(0.0, 1.0, 0.0);
+        float d = _uniform(rs, -10.0f, 10.0f);
+        if (adversarial) {
+            vec3 along = _perpendicular(rs, n);
+            if (pick == 0) {
+                dir = along;
+            }
+            else if (pick == 1) {
+                dir = glm::normalize(along + n * _nudge(rs));
+            }
+            else if (pick == 2) {
+                //on the plane
+                origin = -d * n + along * _uniform(rs, -20.0f, 20.0f);
+            }
+            else {
+                origin = -d * n + n * _nudge(rs);
+            }
+        }
+        _set(c.v + 8, n);
+        c.v[11] = d;
+    }
+    else {
+        vec3 v0 = _point(rs, 10.0f), v1 = _point(rs, 10.0f), v2 = _point(rs, 10.0f);
+        vec3 target = v0 + (v1 - v0) * rs.next_float() * 0.5f + (v2 - v0) * rs.next_float() * 0.5f;
+        if (adversarial) {
+            if (pick == 0) {
+                //through an edge or a vertex
+                float s = (rs.next_float() < 0.3f) ? 0.0f : rs.next_float();
+                target = v0 + (v1 - v0) * s * (1.0f + _nudge(rs));
+            }
+            else if (pick == 1) {
+                //parallel to the triangle's plane
+                target = origin + _perpendicular(rs, glm::cross(v1 - v0, v2 - v0));
+            }
+            else if (pick == 2) {
+                //degenerate, all three in a line
+                v2 = v0 + (v1 - v0) * _uniform(rs, -2.0f, 2.0f);
+            }
+            else {
+                //starting on the triangle
+                origin = target;
+                target = origin + _unit(rs);
+            }
+        }
+        if (rs.next_float() < 0.75f || adversarial) {
+            dir = target - origin;
+        }
+        _set(c.v + 8, v0);
+        _set(c.v + 11, v1);
+        _set(c.v + 14, v2);
+    }
+    _set(c.v, origin);
+    _set(c.v + 3, dir);
+    return c;
+}
+
+std::vector<KernelCheck::Report> KernelCheck::run(long cases) {
+    std::vector<Report> reports(kernels.size());
+    for (unsigned int k = 0; k < kernels.size(); k++) {
+        reports[k].kernel = kernels[k].name;
+        reports[k].kind = kernels[k].kind;
+    }
+
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        bool used = false;
+        for (unsigned int k = 0; k < kernels.size(); k++) {
+            used = used || kernels[k].kind == kind;
+        }
+        if (!used) continue;
+
+        //one stream per kind, adding a kernel elsewhere doesn't move the cases
+        RandomStream rs = RandomStream(seed, kind, 0, 0, 0);
+        for (long i = 0; i < cases; i++) {
+            Case c = generate((Kind)kind, rs, i % 2 == 1);
+            for (unsigned int k = 0; k < kernels.size(); k++) {
+                if (kernels[k].kind != kind) continue;
+                Report &report = reports[k];
+                report.cases++;
+                uint32_t ulps;
+                bool bad = disagrees(kernels[k], c, ulps);
+                if (ulps != UINT32_MAX && ulps > report.max_ulps) report.max_ulps = ulps;
+                if (!bad) continue;
+
+                report.mismatches++;
+                if (report.reproducers.size() < MAX_REPRODUCERS) {
+                    Mismatch m;
+                    m.input = shrink(kernels[k], c);
+                    m.expected = reference(m.input);
+                    m.actual = run_entry(kernels[k], m.input);
+                    disagrees(kernels[k], m.input, m.ulps);
+                    report.reproducers.push_back(m);
+                }
+            }
+        }
+    }
+    return reports;
+}
+
+//static
+void KernelCheck::write_case(std::ostream &out, const Case &c) {
+    //hex floats, so the case can be pasted back in exactly
+    static const char *labels[KIND_COUNT][6] = {
+        {"origin", "direction", "window", "center", "radius", ""},
+        {"origin", "direction", "window", "normal", "distance", ""},
+        {"origin", "point", "window", "v0", "v1", "v2"},
+        {"a b c", "", "", "", "", ""},
+    };
+    static const int starts[6] = {0, 3, 6, 8, 11, 14};
+    static const int counts[KIND_COUNT][6] = {
+        {3, 3, 2, 3, 1, 0},
+        {3, 3, 2, 3, 1, 0},
+        {3, 3, 2, 3, 3, 3},
+        {3, 0, 0, 0, 0, 0},
+    };
+    char line[256];
+    for (int f = 0; f < 6; f++) {
+        int n = counts[c.kind][f];
+        if (n == 0) continue;
+        int len = snprintf(line, sizeof(line), "    %-10s", labels[c.kind][f]);
+        for (int i = 0; i < n; i++) {
+            float x = c.v[starts[f] + i];
+            len += snprintf(line + len, sizeof(line) - len, " %a (%g)", x, x);
+        }
+        out << line << "\n";
+    }
+}
+
+static void _write_result(std::ostream &out, const char *label, const KernelCheck::Result &r, bool quadratic) {
+    char line[128];
+    if (!r.hit) {
+        snprintf(line, sizeof(line), "    %-10s miss", label);
+    }
+    else if (quadratic) {
+        snprintf(line, sizeof(line), "    %-10s %a %a (%g %g)", label, r.t0, r.t1, r.t0, r.t1);
+    }
+    else {
+        snprintf(line, sizeof(line), "    %-10s t %a (%g)", label, r.t0, r.t0);
+    }
+    out << line << "\n";
+}
+
+//static
+void KernelCheck::write_report(std::ostream &out, const std::vector<Report> &reports) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-24s %10s %12s %10s", "kernel", "cases", "mismatches", "max ulps");
+    out << line << "\n";
+    for (unsigned int k = 0; k < reports.size(); k++) {
+        snprintf(line, sizeof(line), "%-24s %10ld %12ld %10u", reports[k].kernel.c_str(),
+            reports[k].cases, reports[k].mismatches, reports[k].max_ulps);
+        out << line << "\n";
+    }
+    for (unsigned int k = 0; k < reports.size(); k++) {
+        const Report &report = reports[k];
+        for (unsigned int m = 0; m < report.reproducers.size(); m++) {
+            const Mismatch &mismatch = report.reproducers[m];
+            out << "\n" << report.kernel << " reproducer " << (m + 1) << ", ";
+            if (mismatch.ulps == UINT32_MAX) out << "hit/miss disagree\n";
+            else out << mismatch.ulps << " ulps apart\n";
+            write_case(out, mismatch.input);
+            _write_result(out, "reference", mismatch.expected, report.kind == QUADRATIC);
+            _write_result(out, "kernel", mismatch.actual, report.kind == QUADRATIC);
+        }
+    }
+    out.flush();
+}
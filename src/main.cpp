@@ -14,18 +14,71 @@
 #include "gtest/gtest.h"
 #include "src/camera.h"
 #include "src/texture.hpp"
+#include "src/rng.hpp"
+#include "src/distributed.hpp"
+#include "src/bvh.hpp"
+#include "src/instance.hpp"
+#include "src/framebuffer.hpp"
+#include "src/unbounded.hpp"
+#include "src/kernel_check.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <set>
 
 using namespace std;
 
 //global
 const bool RUN_TEST = true;
-int HIT_COUNT = 0;
-int LIGHT_HIT_COUNT = 0;
+std::atomic<int> HIT_COUNT(0);
+std::atomic<int> LIGHT_HIT_COUNT(0);
 const bool LIGHT_VISIBLE = true;
 const int NUM_OBJECTS = 3;
 const int MAX_REFLECTIONS = 1;
 const bool USE_TEXTURES = true;
-Object* objects[NUM_OBJECTS];
+const int SAMPLES_PER_PIXEL = 1; //>1 jitters camera rays inside the pixel
+const uint32_t RNG_SEED = 0x5eed;
+const double TILE_TIMEOUT = 30.0; //seconds before a slow worker's tile is handed out again
+const int STREAM_BANDS = 4; //tile rows a streamed image keeps in memory
+const unsigned int PACKET_MAX_CANDIDATES = 16; //more objects in a tile's frustum and rays go through the BVH
+std::atomic<int> PACKET_TILES(0);
+const float SHADOW_EPSILON = 0.001; //shadow rays start this far off the surface
+const float SHADOW_STRENGTH = 0.5; //fraction of colour lost when every light is blocked
+std::atomic<long> SHADOW_RAYS(0);
+std::atomic<long> OCCLUDER_LOOKUPS(0);
+std::atomic<long> OCCLUDER_HITS(0);
+const int IRRADIANCE_THETAS = 6; //hemisphere strata per new irradiance record
+const int IRRADIANCE_PHIS = 18;
+const float INDIRECT_STRENGTH = 0.5; //scale of bounced light against the surface colour
+std::atomic<long> IRRADIANCE_LOOKUPS(0);
+const uint32_t PHOTON_SEED = 0x9407;
+const float LIGHT_POWER = 200.0; //flux of each point light, shared by its photons
+const int PHOTON_BOUNCES = 4;
+const int PHOTON_CHUNKS = 64; //emission work items, each keeps an equal share of the budget
+const int PHOTON_NEIGHBOURS = 50; //photons per density estimate
+const float PHOTON_RADIUS = 1.0; //largest disc a density estimate gathers from
+const float PHOTON_STRENGTH = 0.5; //scale of photon light against the surface colour
+const float THROUGHPUT_CUTOFF = 0.05; //weaker paths only go on through russian roulette
+const int ROULETTE_MIN_DEPTH = 3; //reflections traced before roulette applies to every path
+const float ROULETTE_MAX_SURVIVAL = 0.95; //even bright paths end eventually
+std::atomic<long> ROULETTE_KILLED(0);
+std::atomic<long> ROULETTE_SURVIVED(0);
+std::vector<Object*> objects;
+std::vector<Geometry*> geometries; //shared by instances in objects
+BVH scene_bvh; //bounded objects
+UnboundedSet scene_unbounded; //planes and lights without a position
+std::vector<Light*> scene_lights; //point lights, targets of shadow rays
+bool scene_textures = false; //some object is textured, picks the integrator
+IrradianceCache irradiance_cache; //shared by every thread, filled while rendering
+PhotonMap photon_map(256 << 20); //rebuilt before each frame when photons are on
+Profiler profiler; //phase timings, reported after rendering
+static thread_local long RAYS_CAST = 0; //this thread's closest hit and shadow queries
+const int BENCH_RAYS = 1 << 20;
+const uint32_t BENCH_SEED = 0xbe7c;
+const uint32_t KERNEL_CHECK_SEED = 0xd1ff;
+const uint32_t KERNEL_CHECK_ULPS = 0; //the scalar variants match their references bit for bit
 
 /*
 void init_objects() {
@@ -42,6 +95,8 @@ void init_objects() {
 
 void object_setup()
 {
+    objects.assign(NUM_OBJECTS, NULL);
+
     mat4 tr = Transform::translate(-2.0, 3.0, -13.0);
     Light *light1 = new Light(1.0, &tr, vec4(1.0, 1.0, 1.0, 0.5), 0.97, LightType::point);
 
@@ -65,173 +120,1063 @@ void object_setup()
     //objects[2] = sphere2;
     objects[2] = plane1;
 	//objects[4] = triangle1;
+
+    //whichever of these aren't in the scene have no other owner
+    if (std::find(objects.begin(), objects.end(), sphere2) == objects.end()) delete sphere2;
+    if (std::find(objects.begin(), objects.end(), triangle1) == objects.end()) delete triangle1;
+}
+
+//scatters copies of one small tree behind the default scene
+void instancing_setup(int count)
+{
+    Geometry *tree = new Geometry();
+    mat4 tr = Transform::translate(0.0, 0.0, 0.0);
+    tree->add(new Sphere(0.15, &tr, vec4(0.4, 0.25, 0.1, 1.0), 0.97));
+    tr = Transform::translate(0.0, 0.6, 0.0);
+    tree->add(new Sphere(0.45, &tr, vec4(0.1, 0.5, 0.1, 1.0), 0.97));
+    tr = Transform::translate(0.0, 1.1, 0.0);
+    tree->add(new Sphere(0.3, &tr, vec4(0.1, 0.6, 0.1, 1.0), 0.97));
+    tree->build();
+    geometries.push_back(tree);
+
+    int side = (int)ceil(sqrt((float)count));
+    for (int i = 0; i < count; i++) {
+        float x = (i % side) - side * 0.5;
+        float z = -20.0 - (i / side);
+        float degrees = (i * 37) % 360;
+        float s = 0.8 + 0.05 * (i % 7);
+        mat4 otw = Transform::translate(x, -1.0 + 0.15 * s, z) *
+            mat4(Transform::rotate(degrees, vec3(0.0, 1.0, 0.0))) *
+            Transform::scale(s, s, s);
+        objects.push_back(new Instance(tree, &otw, vec4(0.1, 0.5, 0.1, 1.0)));
+    }
 }
 
 void object_teardown()
 {
-    for (int i = 0; i < NUM_OBJECTS; i++) {
+    for (unsigned int i = 0; i < objects.size(); i++) {
         delete objects[i];
     }
+    objects.clear();
+    scene_unbounded.clear();
+    scene_lights.clear();
+    for (unsigned int i = 0; i < geometries.size(); i++) {
+        delete geometries[i];
+    }
+    geometries.clear();
 }
 
 void world_teardown(Camera *camera)
 {
     object_teardown();
     delete camera;
+    //the acceleration structure outlives the objects otherwise,
+    //and would show up as a leak in the memory report
+    scene_bvh = BVH();
+}
+
+//splits objects into the BVH and the unbounded list
+void compile_scene()
+{
+    std::vector<Object*> bounded;
+    scene_unbounded.clear();
+    scene_lights.clear();
+    scene_textures = false;
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        if (objects[i]->has_texture && USE_TEXTURES) {
+            scene_textures = true;
+        }
+        if (objects[i]->type == ObjType::light && ((Light*)objects[i])->ltype == LightType::point) {
+            scene_lights.push_back((Light*)objects[i]);
+        }
+        if (objects[i]->get_bounds().is_infinite()) {
+            scene_unbounded.add(objects[i]);
+        }
+        else {
+            bounded.push_back(objects[i]);
+        }
+    }
+    scene_bvh.build(bounded);
+}
+
+//every texture the scene refers to, once each
+static std::vector<std::string> texture_paths()
+{
+    std::set<std::string> paths;
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        if (objects[i]->has_texture && objects[i]->texture_filepath != "") {
+            paths.insert(objects[i]->texture_filepath);
+        }
+    }
+    for (unsigned int g = 0; g < geometries.size(); g++) {
+        for (unsigned int i = 0; i < geometries[g]->prims.size(); i++) {
+            Object *prim = geometries[g]->prims[i];
+            if (prim->has_texture && prim->texture_filepath != "") {
+                paths.insert(prim->texture_filepath);
+            }
+        }
+    }
+    return std::vector<std::string>(paths.begin(), paths.end());
 }
 
-Camera* world_setup()
+//with a pool, textures decode on it while the BVH builds here, and setup
+//returns once they are resident; without one they load on first lookup
+Camera* world_setup(const RenderOptions &options, ThreadPool *pool)
 {
     mat4 matv = mat4(1.0);
     mat4 *matp = &matv;
-    Camera *camp = new Camera(matp, 1024, 768, 45.0, 45.0, vec3(0.0));
+    Camera *camp = new Camera(matp, options.width, options.height, 45.0, 45.0, vec3(0.0));
 
     object_setup();
+    if (options.instances > 0) {
+        instancing_setup(options.instances);
+    }
+    if (pool != NULL && USE_TEXTURES) {
+        TextureManager::preload(texture_paths(), *pool, profiler);
+    }
+    {
+        ScopedTimer timer(profiler, "bvh");
+        compile_scene();
+    }
+    if (pool != NULL) {
+        //what's left of the decodes once the BVH is done
+        ScopedTimer timer(profiler, "textures");
+        pool->wait();
+    }
     return camp;
 }
 
-struct Hit
-{
-    bool is_hit = false;
-    vec3 hit, n;
-    float d1, d2;
-    ObjType type;
-    Object *obj;
-    vec4 color;
-    bool has_texture;
-    std::string texture_path;
-};
-
 int NUM_HIT_SPHERE = 0;
 int NUM_CREATED = 0;
 ofstream myfile;
 
-void trace_ray(Ray *ray, Pixel &pixel, int reflections, bool track=false)
+//the record's t is the open end of the search interval, every hit shrinks it
+static inline void test_object(const Ray &ray, Object *obj, HitRecord &closest)
+{
+    float t;
+    int prim;
+    if (obj->intersects(ray, 0.0f, closest.t, t, prim)) {
+        HIT_COUNT++;
+        closest.t = t;
+        closest.object = obj;
+        closest.prim = prim;
+    }
+}
+
+//unbounded objects go first, a ground plane hit shortens the BVH walk
+static void closest_hit(const Ray &ray, HitRecord &closest)
+{
+    RAYS_CAST++;
+    if (scene_unbounded.intersect(ray, 0.0f, closest)) {
+        HIT_COUNT++;
+    }
+    scene_bvh.traverse(ray, closest.t, [&](Object *obj) {
+        test_object(ray, obj, closest);
+    });
+}
+
+//same, over objects already culled for this ray's packet
+static void closest_hit(const Ray &ray, const std::vector<Object*> &candidates, HitRecord &closest)
+{
+    RAYS_CAST++;
+    if (scene_unbounded.intersect(ray, 0.0f, closest)) {
+        HIT_COUNT++;
+    }
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        test_object(ray, candidates[i], closest);
+    }
+}
+
+long rays_cast()
+{
+    return RAYS_CAST;
+}
+
+bool occluded(const vec3 &point, int slot, OccluderCache *cache)
+{
+    SHADOW_RAYS++;
+    Light *light = scene_lights[slot];
+    vec3 to_light = vec3(light->center) - point;
+    float distance = glm::length(to_light);
+    //stop at the light's surface, the light itself never blocks
+    float tmax = distance - light->radius;
+    if (tmax <= SHADOW_EPSILON) return false;
+    RAYS_CAST++;
+    Ray ray = Ray(point, to_light / distance, RayType::shadow, 0);
+
+    float t;
+    int prim;
+    if (cache != NULL && cache->get(slot) != NULL) {
+        cache->lookups++;
+        if (cache->get(slot)->intersects(ray, SHADOW_EPSILON, tmax, t, prim)) {
+            cache->hits++;
+            return true;
+        }
+    }
+
+    HitRecord blocker;
+    blocker.t = tmax;
+    scene_unbounded.intersect(ray, SHADOW_EPSILON, blocker);
+    if (blocker.object == NULL) {
+        //any hit will do, a negative tmax ends the traversal
+        float limit = tmax;
+        scene_bvh.traverse(ray, limit, [&](Object *obj) {
+            if (obj->type != ObjType::light && obj->intersects(ray, SHADOW_EPSILON, limit, t, prim)) {
+                blocker.object = obj;
+                limit = -1.0;
+            }
+        });
+    }
+    if (blocker.object != NULL && blocker.object->type == ObjType::light) {
+        //ambient light in the unbounded list, it doesn't block either
+        blocker.object = NULL;
+    }
+
+    if (cache != NULL && blocker.object != NULL) {
+        cache->set(slot, blocker.object);
+    }
+    return blocker.object != NULL;
+}
+
+//irradiance arriving at a surface point, interpolated from the cache or
+//sampled into a new record when nothing close enough is there yet
+static vec3 indirect_irradiance(const vec3 &point, const vec3 &n, IrradianceCache *cache)
+{
+    IRRADIANCE_LOOKUPS++;
+    vec3 irradiance;
+    if (cache->lookup(point, n, irradiance)) {
+        return irradiance;
+    }
+
+    //keyed by the point, so a record doesn't depend on which thread made it
+    uint32_t bits[3];
+    memcpy(bits, &point, sizeof(bits));
+    RandomStream rs = RandomStream(RNG_SEED, bits[0] ^ bits[2], bits[1], 0, 1);
+    IrradianceRecord rec = cache->sample(point, n, IRRADIANCE_THETAS, IRRADIANCE_PHIS, rs,
+        [](const vec3 &origin, const vec3 &dir, vec3 &radiance) {
+            Ray ray = Ray(origin, dir, RayType::shadow, 0);
+            HitRecord hit;
+            closest_hit(ray, hit);
+            if (hit.object == NULL) {
+                radiance = vec3(0.0);
+                return (float)INFINITY;
+            }
+            //one bounce of flat colour, textures aren't looked up here
+            radiance = vec3(hit.object->color);
+            //ambient lights are hit at FLT_MAX, they're infinitely far away
+            return hit.t == FLT_MAX ? (float)INFINITY : hit.t;
+        });
+    cache->insert(rec);
+    return rec.irradiance;
+}
+
+//follows one photon from its light, storing it at every surface it lands on
+//and continuing with russian roulette on the surface colour
+static void trace_photon(long index, long count, std::vector<Photon> &stored, size_t limit)
+{
+    RandomStream rs = RandomStream(PHOTON_SEED, (uint32_t)index, (uint32_t)(index >> 32), 0, 0);
+    Light *light = scene_lights[index % scene_lights.size()];
+
+    //uniform over the sphere, starting on the light's surface
+    float z = 1.0 - 2.0 * rs.next_float();
+    float r = sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 2.0 * M_PI * rs.next_float();
+    vec3 dir = vec3(r * std::cos(phi), r * std::sin(phi), z);
+    vec3 origin = vec3(light->center) + dir * (light->radius + SHADOW_EPSILON);
+    vec3 power = vec3(light->color) * (LIGHT_POWER / std::max(1L, count / (long)scene_lights.size()));
+
+    for (int bounce = 0; bounce < PHOTON_BOUNCES && stored.size() < limit; bounce++) {
+        Ray ray = Ray(origin, dir, RayType::shadow, 0);
+        HitRecord hit;
+        closest_hit(ray, hit);
+        if (hit.object == NULL || hit.object->type == ObjType::light) {
+            return;
+        }
+        SurfaceInteraction si;
+        hit.object->compute_surface_interaction(ray, hit, si);
+        stored.push_back(Photon::pack(si.position, power, dir));
+
+        vec3 albedo = vec3(hit.object->color);
+        float survive = std::max(albedo.r, std::max(albedo.g, albedo.b));
+        if (rs.next_float() >= survive) {
+            return;
+        }
+        power *= albedo / survive;
+
+        //cosine weighted about the side the photon came from
+        vec3 n = glm::dot(si.n, dir) > 0.0 ? -si.n : si.n;
+        vec3 helper = fabs(n.x) > 0.9 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        vec3 tu = glm::normalize(glm::cross(helper, n));
+        vec3 tv = glm::cross(n, tu);
+        float sin_theta = sqrt(rs.next_float());
+        float cos_theta = sqrt(std::max(0.0f, 1.0f - sin_theta * sin_theta));
+        phi = 2.0 * M_PI * rs.next_float();
+        dir = sin_theta * (std::cos(phi) * tu + std::sin(phi) * tv) + cos_theta * n;
+        origin = si.position + n * SHADOW_EPSILON;
+    }
+}
+
+void emit_photons(long count, ThreadPool &pool)
+{
+    photon_map.clear();
+    if (scene_lights.empty() || count <= 0) return;
+
+    //chunks keep their photons in index order, so the map doesn't depend
+    //on which thread ran which chunk
+    size_t share = photon_map.capacity() / PHOTON_CHUNKS;
+    std::vector<std::vector<Photon> > chunks(PHOTON_CHUNKS);
+    std::vector<long> emitted(PHOTON_CHUNKS, 0);
+    pool.parallel_for(PHOTON_CHUNKS, [&](int c) {
+        long begin = count * c / PHOTON_CHUNKS;
+        long end = count * (c + 1) / PHOTON_CHUNKS;
+        for (long i = begin; i < end && chunks[c].size() < share; i++) {
+            trace_photon(i, count, chunks[c], share);
+            emitted[c]++;
+        }
+    });
+
+    //a chunk that ran out of room carries the flux of the photons it never
+    //shot, so a tight budget makes indirect light noisier, not darker
+    for (int c = 0; c < PHOTON_CHUNKS; c++) {
+        long requested = count * (c + 1) / PHOTON_CHUNKS - count * c / PHOTON_CHUNKS;
+        if (emitted[c] == 0 || emitted[c] == requested) continue;
+        float scale = (float)requested / emitted[c];
+        for (unsigned int p = 0; p < chunks[c].size(); p++) {
+            chunks[c][p].set_power(chunks[c][p].get_power() * scale);
+        }
+    }
+
+    std::vector<Photon> photons;
+    size_t total = 0;
+    for (int c = 0; c < PHOTON_CHUNKS; c++) {
+        total += chunks[c].size();
+    }
+    photons.reserve(total);
+    for (int c = 0; c < PHOTON_CHUNKS; c++) {
+        photons.insert(photons.end(), chunks[c].begin(), chunks[c].end());
+        std::vector<Photon>().swap(chunks[c]);
+    }
+    photon_map.build(photons, pool);
+}
+
+//adds diffuse light arriving at the surface on top of its colour
+static void add_diffuse(Pixel &pixel, const vec3 &irradiance, float strength)
+{
+    vec3 albedo = vec3(pixel.color);
+    vec3 lit = albedo + albedo * irradiance * (float)(strength / M_PI);
+    pixel.set_color(vec4(glm::min(lit, vec3(1.0)), pixel.color.a));
+}
+
+template <class F>
+static int reflection_limit(const TraceContext *context)
+{
+    if (F::max_depth > 0) {
+        return F::max_depth;
+    }
+    if (context != NULL && context->max_reflections > 0) {
+        return context->max_reflections;
+    }
+    return MAX_REFLECTIONS;
+}
+
+//fraction of the light a surface passes on to its reflection
+static float reflectance(const Object *obj)
+{
+    return (obj->color.r + obj->color.g + obj->color.b) / 3.0;
+}
+
+//russian roulette on a new reflection
+//a path below the cutoff, or any path past the minimum depth, survives with
+//probability tied to its throughput and carries 1 / probability more light
+//when it does, so on average it contributes exactly what it would have
+static bool continue_path(const vec3 &origin, const vec3 &dir, int reflections, float &throughput, const TraceContext *context)
+{
+    if (context == NULL || !context->roulette) return true;
+
+    float survive = 1.0;
+    if (throughput < THROUGHPUT_CUTOFF) {
+        survive = throughput / THROUGHPUT_CUTOFF;
+    }
+    else if (reflections >= ROULETTE_MIN_DEPTH) {
+        survive = std::min(throughput, ROULETTE_MAX_SURVIVAL);
+    }
+    if (survive >= 1.0) return true;
+
+    //keyed by the ray itself, the same path gets the same decision on any thread
+    uint32_t o[3], d[3];
+    memcpy(o, &origin, sizeof(o));
+    memcpy(d, &dir, sizeof(d));
+    RandomStream rs = RandomStream(RNG_SEED, o[0] ^ d[2], o[1] ^ d[0], o[2] ^ d[1], reflections);
+    if (rs.next_float() >= survive) {
+        ROULETTE_KILLED++;
+        return false;
+    }
+    ROULETTE_SURVIVED++;
+    throughput /= survive;
+    return true;
+}
+
+template <class F>
+static void trace_kernel(Ray*, Pixel&, int, const TraceContext*);
+
+//mirror reflection off the hit, traced now or queued for the next generation
+template <class F>
+static void reflect(Ray *ray, const SurfaceInteraction &si, float throughput, Pixel &pixel, int reflections, const TraceContext *context)
 {
-    if (reflections > MAX_REFLECTIONS) {
+    RayQueue *deferred = context != NULL ? context->deferred : NULL;
+    vec3 dir = (Transform::reflect(ray->direction, si.n));
+    dir = glm::normalize(dir);
+    if (!continue_path(si.position, dir, reflections, throughput, context)) {
+        return;
+    }
+
+    if (deferred != NULL) {
+        QueuedRay next = {si.position, dir, RayType::shadow, &pixel, reflections, throughput};
+        deferred->push(next);
+    }
+    else {
+        Ray *nray = new Ray(si.position, dir, RayType::shadow);
+        nray->throughput = throughput;
+        trace_kernel<F>(nray, pixel, reflections, context);
+        delete nray;
+    }
+}
+
+//colour of the surface at the hit, from its texture if it has one
+//false if the texture can't be read there
+template <bool Textures>
+static bool surface_color(Object *obj, const SurfaceInteraction &si, vec4 &color)
+{
+    if (Textures && obj->has_texture) {
+        vec3 rgb = vec3(0.0);
+        if (!TextureManager::get_uv_pixel_color(rgb, obj->texture_filepath, si.u, si.v)) {
+            return false;
+        }
+        color = vec4(rgb.r, rgb.g, rgb.b, 1.0);
+        return true;
+    }
+    color = obj->color;
+    return true;
+}
+
+template <class F>
+static void shade_hit(Ray *ray, const HitRecord &closest, Pixel &pixel, int reflections, const TraceContext *context)
+{
+    if (closest.object == NULL) {
+        return;
+    }
+
+    Object *obj = closest.object;
+    if (ray->type == RayType::camera) {
+        if (obj->type == ObjType::light && LIGHT_VISIBLE) {
+            pixel.set_color(obj->color);
+        }
+        else if (obj->type != ObjType::light) {
+            //only the winning hit pays for the hit point, normal and uv
+            SurfaceInteraction si;
+            obj->compute_surface_interaction(*ray, closest, si);
+
+            vec4 color;
+            if (surface_color<F::textures>(obj, si, color)) {
+                pixel.set_color(color);
+            }
+
+            if (F::shadows != ShadowMode::none && !scene_lights.empty()) {
+                OccluderCache *cache = (F::shadows == ShadowMode::cached) ? context->occluders : NULL;
+                int blocked = 0;
+                for (unsigned int l = 0; l < scene_lights.size(); l++) {
+                    if (occluded(si.position, l, cache)) {
+                        blocked++;
+                    }
+                }
+                float keep = 1.0 - SHADOW_STRENGTH * blocked / scene_lights.size();
+                pixel.set_color(vec4(vec3(pixel.color) * keep, pixel.color.a));
+            }
+
+            //face the normal towards the viewer, planes have one side
+            vec3 facing = glm::dot(si.n, ray->direction) > 0.0 ? -si.n : si.n;
+            if (context != NULL && context->irradiance != NULL) {
+                vec3 irradiance = indirect_irradiance(si.position + facing * SHADOW_EPSILON, facing, context->irradiance);
+                add_diffuse(pixel, irradiance, INDIRECT_STRENGTH);
+            }
+
+            if (context != NULL && context->photons != NULL) {
+                if (context->photon_batch != NULL) {
+                    PhotonQuery query = {si.position, facing};
+                    context->photon_batch->queries.push_back(query);
+                    context->photon_batch->pixels.push_back(&pixel);
+                }
+                else {
+                    vec3 irradiance = context->photons->irradiance(si.position, facing, PHOTON_NEIGHBOURS, PHOTON_RADIUS);
+                    add_diffuse(pixel, irradiance, PHOTON_STRENGTH);
+                }
+            }
+
+            //fire a new ray
+            reflect<F>(ray, si, ray->throughput, pixel, reflections, context);
+        }
+    }
+    else if (ray->type == RayType::shadow) {
+        if (obj->type == ObjType::light) {
+            LIGHT_HIT_COUNT++;
+            vec4 light = obj->color;
+            light.a *= ray->throughput;
+            pixel.add_alpha_color(light);
+        }
+        else if (reflections <= reflection_limit<F>(context)) {
+            //mirror chains go on, each surface keeps part of the light
+            SurfaceInteraction si;
+            obj->compute_surface_interaction(*ray, closest, si);
+            reflect<F>(ray, si, ray->throughput * reflectance(obj), pixel, reflections, context);
+        }
+    }
+}
+
+template <class F>
+static void trace_kernel(Ray *ray, Pixel &pixel, int reflections, const TraceContext *context)
+{
+    if (reflections > reflection_limit<F>(context)) {
         return;
     }
     else {
         reflections++;
     }
 
-    if (track) {
+    if (F::tracking) {
         cout << "tracked ray " << endl;
         cout << *ray << endl;
     }
 
-    float nearest = INFINITY;
-    float dist1, dist2;
-    vec3 hit, n;
-    Hit hit_result;
-
-    for (int k = 0; k < NUM_OBJECTS; k++) {
-	    Object* obj = objects[k];
-        if (obj->intersects(*ray, hit, n, dist1, dist2)) {
-            if (abs(dist1) < nearest) {
-                hit_result = Hit();
-                HIT_COUNT++;
-                nearest = abs(dist1);
-                hit_result.is_hit = true;
-                hit_result.hit = hit;
-                hit_result.n = n;
-                hit_result.d1 = dist1;
-                hit_result.d2 = dist2;
-                hit_result.type = obj->type;
-                hit_result.color = obj->color;
-                hit_result.has_texture = obj->has_texture;
-                hit_result.texture_path = obj->texture_filepath;
-                hit_result.obj = obj;
-            }
+    HitRecord closest;
+    closest_hit(*ray, closest);
+    shade_hit<F>(ray, closest, pixel, reflections, context);
+}
+
+std::vector<Tile> make_tiles(Camera *camera, int tile_size)
+{
+    std::vector<Tile> tiles;
+    int width = camera->width;
+    int height = camera->height;
+    for (int y = 0; y < height; y += tile_size) {
+        for (int x = 0; x < width; x += tile_size) {
+            Tile tile;
+            tile.x0 = x;
+            tile.y0 = y;
+            tile.x1 = std::min(x + tile_size, width);
+            tile.y1 = std::min(y + tile_size, height);
+            tiles.push_back(tile);
         }
     }
+    return tiles;
+}
+
+//camera ray direction for one sample of pixel (i, j)
+//leaves pixel remapped and cleared to opaque black
+static vec3 setup_sample(Pixel &pixel, int i, int j, int s)
+{
+    if (SAMPLES_PER_PIXEL > 1) {
+        //stream is keyed by pixel and sample, not by draw order
+        RandomStream rs = RandomStream(RNG_SEED, i, j, s, 0);
+        pixel.x += rs.next_float() - 0.5;
+        pixel.y += rs.next_float() - 0.5;
+    }
+    pixel.remap();
+    pixel.set_color(vec4(0.0, 0.0, 0.0, 1.0));
+
+    vec3 direction = vec3(pixel.x, pixel.y, -1.0); //direction of negative z
+    return glm::normalize(direction);
+}
+
+//Camera rays of one tile as a packet
+//Every ray of the tile starts at the camera and lies inside the frustum through
+//the tile's corners, so objects whose BVH leaves miss the frustum can't be hit
+//by any of them. If too many objects survive, testing each ray against the
+//list costs more than the BVH and the tile falls back to per-ray traversal.
+struct TilePacket
+{
+    bool coherent;
+    std::vector<Object*> candidates;
+};
+
+static void build_packet(Camera *camera, const Tile &tile, TilePacket &packet)
+{
+    //pixel space corners, a hair wider than the jittered samples can reach
+    const float slack = 0.01;
+    float xs[4] = {tile.x0 - slack, tile.x1 + slack, tile.x1 + slack, tile.x0 - slack};
+    float ys[4] = {tile.y0 - slack, tile.y0 - slack, tile.y1 + slack, tile.y1 + slack};
+    vec3 corners[4];
+    for (int c = 0; c < 4; c++) {
+        //remap() measures from pixel centers
+        Pixel pixel = Pixel(0, 0, camera);
+        pixel.x = xs[c] - 0.5;
+        pixel.y = ys[c] - 0.5;
+        pixel.remap();
+        corners[c] = vec3(pixel.x, pixel.y, -1.0);
+    }
+
+    packet.coherent = scene_bvh.cull(Frustum(vec3(0.0), corners), packet.candidates, PACKET_MAX_CANDIDATES);
+    if (packet.coherent) {
+        PACKET_TILES++;
+    }
+}
+
+//trace_ray for a camera ray of the packet's tile
+template <class F>
+static void trace_primary(Ray *ray, Pixel &pixel, const TilePacket *packet, const TraceContext *context)
+{
+    if (packet == NULL || !packet->coherent) {
+        trace_kernel<F>(ray, pixel, 0, context);
+        return;
+    }
+    HitRecord closest;
+    closest_hit(*ray, packet->candidates, closest);
+    //camera rays are the first reflection, as in trace_ray
+    shade_hit<F>(ray, closest, pixel, 1, context);
+}
 
-    if (hit_result.is_hit) {
-        if (ray->type == RayType::camera) {
-            if (hit_result.type == ObjType::light && LIGHT_VISIBLE) {
-                pixel.set_color(hit_result.color);
+//wavefront version of render_tile
+//camera rays are traced first and every secondary ray they spawn is queued,
+//then each generation is sorted by RayQueue before it is traced
+template <class F>
+static void render_tile_sorted(Camera *camera, const Tile &tile, vec3 *rgb, const TilePacket *packet, const TraceContext &context)
+{
+    //reserved up front, queued rays point into this
+    std::vector<Pixel> pixels;
+    pixels.reserve(tile.size() * SAMPLES_PER_PIXEL);
+
+    RayQueue queue, next;
+    TraceContext to_queue = context;
+    to_queue.deferred = &queue;
+    TraceContext to_next = context;
+    to_next.deferred = &next;
+    PhotonBatch batch;
+    if (context.photons != NULL) {
+        to_queue.photon_batch = &batch;
+    }
+    for (int j = tile.y0; j < tile.y1; j++) {
+        for (int i = tile.x0; i < tile.x1; i++) {
+            for (int s = 0; s < SAMPLES_PER_PIXEL; s++) {
+                pixels.push_back(Pixel(i, j, camera));
+                vec3 direction = setup_sample(pixels.back(), i, j, s);
+                Ray ray = Ray(vec3(0.0), direction, RayType::camera);
+                trace_primary<F>(&ray, pixels.back(), packet, &to_queue);
             }
-            else if (hit_result.type != ObjType::light) {
-                if (hit_result.has_texture && USE_TEXTURES) {
-                    //this is temporary
-                    //TODO: Figure out dynamic casting here
-                    Sphere *sp = (Sphere*)hit_result.obj;
-                    float u, v;
-                    sp->get_uv(hit_result.n, u, v);
-                    //std::cout << u << " " << v << std::endl;
-                    vec3 rgb = vec3(0.0);
-                    if (TextureManager::get_uv_pixel_color(
-                        rgb,
-                        hit_result.texture_path,
-                        u,
-                        v))
-                    {
-                        vec4 rgb4 = vec4(rgb.r, rgb.g, rgb.b, 1.0);
-                        pixel.set_color(rgb4);
-                    };
-                } else {
-                    pixel.set_color(hit_result.color);
-                }
-                //fire a new ray
-                vec3 dir = (Transform::reflect(ray->direction, hit_result.n));
-                dir = glm::normalize(dir);
-                Ray *nray = new Ray(hit_result.hit, dir, RayType::shadow);
-                trace_ray(nray, pixel, reflections, track);
-                delete nray;
+        }
+    }
+
+    //the whole tile's camera hits in one pass over the photon map, before
+    //the reflections add to the same pixels
+    if (!batch.queries.empty()) {
+        std::vector<vec3> irradiance;
+        context.photons->irradiance_batch(batch.queries, PHOTON_NEIGHBOURS, PHOTON_RADIUS, irradiance);
+        for (unsigned int q = 0; q < batch.pixels.size(); q++) {
+            add_diffuse(*batch.pixels[q], irradiance[q], PHOTON_STRENGTH);
+        }
+    }
+
+    while (!queue.empty()) {
+        queue.sort();
+        for (unsigned int r = 0; r < queue.size(); r++) {
+            const QueuedRay &q = queue.rays[r];
+            Ray ray = Ray(q.origin, q.direction, q.type);
+            ray.throughput = q.throughput;
+            trace_kernel<F>(&ray, *q.pixel, q.reflections, &to_next);
+        }
+        queue.swap(next);
+        next.clear();
+    }
+
+    for (int p = 0; p < tile.size(); p++) {
+        vec3 rgb_color = vec3(0.0);
+        for (int s = 0; s < SAMPLES_PER_PIXEL; s++) {
+            rgb_color += pixels[p * SAMPLES_PER_PIXEL + s].convert_rgba_to_rgb(vec4(1.0));
+        }
+        rgb[p] = rgb_color / (float)SAMPLES_PER_PIXEL;
+    }
+}
+
+template <class F>
+static void render_tile_depth_first(Camera *camera, const Tile &tile, vec3 *rgb, const TilePacket *packet, const TraceContext &context)
+{
+    for (int j = tile.y0; j < tile.y1; j++) {
+        for (int i = tile.x0; i < tile.x1; i++) {
+            vec3 rgb_color = vec3(0.0);
+            for (int s = 0; s < SAMPLES_PER_PIXEL; s++) {
+                //base pixel remapping
+                Pixel pixel = Pixel(i, j, camera);
+                vec3 direction = setup_sample(pixel, i, j, s);
+                vec3 origin = vec3(0.0);
+
+                //initial camera ray
+                Ray *ray = new Ray(origin, direction, RayType::camera);
+                trace_primary<F>(ray, pixel, packet, &context);
+                delete ray;
+
+                rgb_color += pixel.convert_rgba_to_rgb(vec4(1.0));
             }
+            rgb[(j - tile.y0) * tile.width() + (i - tile.x0)] = rgb_color / (float)SAMPLES_PER_PIXEL;
         }
-        else if (ray->type == RayType::shadow) {
-            if (hit_result.type == ObjType::light) {
-                LIGHT_HIT_COUNT++;
-                pixel.add_alpha_color(hit_result.color);
+    }
+}
+
+//One instantiation of the integrator, see FeaturePolicy
+struct Integrator
+{
+    bool textures;
+    ShadowMode shadows;
+    int max_depth;
+    void (*trace)(Ray*, Pixel&, int, const TraceContext*);
+    void (*render_sorted)(Camera*, const Tile&, vec3*, const TilePacket*, const TraceContext&);
+    void (*render_depth_first)(Camera*, const Tile&, vec3*, const TilePacket*, const TraceContext&);
+};
+
+template <class F>
+static Integrator make_integrator()
+{
+    Integrator integrator = {F::textures, F::shadows, F::max_depth, trace_kernel<F>, render_tile_sorted<F>, render_tile_depth_first<F>};
+    return integrator;
+}
+
+//MAX_REFLECTIONS is built in unless the limit has to be read per ray
+//tracking is for single rays handed to trace_ray, it never renders tiles
+template <bool Textures, ShadowMode Shadows>
+static const Integrator& select_depth(bool fixed_depth, bool tracking)
+{
+    static const Integrator fixed = make_integrator<FeaturePolicy<Textures, Shadows, MAX_REFLECTIONS, false> >();
+    static const Integrator any = make_integrator<FeaturePolicy<Textures, Shadows, 0, false> >();
+    static const Integrator tracked = make_integrator<FeaturePolicy<Textures, Shadows, 0, true> >();
+    if (tracking) {
+        return tracked;
+    }
+    return fixed_depth ? fixed : any;
+}
+
+template <bool Textures>
+static const Integrator& select_shadows(ShadowMode shadows, bool fixed_depth, bool tracking)
+{
+    if (shadows == ShadowMode::traced) {
+        return select_depth<Textures, ShadowMode::traced>(fixed_depth, tracking);
+    }
+    else if (shadows == ShadowMode::cached) {
+        return select_depth<Textures, ShadowMode::cached>(fixed_depth, tracking);
+    }
+    return select_depth<Textures, ShadowMode::none>(fixed_depth, tracking);
+}
+
+static const Integrator& select_integrator(bool textures, ShadowMode shadows, bool fixed_depth, bool tracking)
+{
+    if (textures) {
+        return select_shadows<true>(shadows, fixed_depth, tracking);
+    }
+    return select_shadows<false>(shadows, fixed_depth, tracking);
+}
+
+static ShadowMode shadow_mode(bool shadow_rays, bool cached)
+{
+    if (!shadow_rays) {
+        return ShadowMode::none;
+    }
+    return cached ? ShadowMode::cached : ShadowMode::traced;
+}
+
+//the scene's textures come from compile_scene, the rest from the options
+static const Integrator& select_integrator(const RenderOptions &options)
+{
+    ShadowMode shadows = shadow_mode(options.shadow_rays, options.occluder_cache);
+    if (!options.specialize) {
+        //shadows change the image, everything else is read as it's needed
+        return select_integrator(USE_TEXTURES, shadows, false, false);
+    }
+    bool fixed_depth = options.reflections == 0 || options.reflections == MAX_REFLECTIONS;
+    return select_integrator(scene_textures, shadows, fixed_depth, false);
+}
+
+std::string integrator_name(const RenderOptions &options)
+{
+    static const char *shadows[] = {"none", "traced", "cached"};
+    const Integrator &integrator = select_integrator(options);
+    std::string name = std::string("textures ") + (integrator.textures ? "on" : "off");
+    name += std::string(", shadows ") + shadows[(int)integrator.shadows];
+    name += ", depth " + (integrator.max_depth > 0 ? std::to_string(integrator.max_depth) : std::string("any"));
+    return name;
+}
+
+//not the tile path, so it takes the general kernel for whatever the context asks
+void trace_ray(Ray *ray, Pixel &pixel, int reflections, bool track, const TraceContext *context)
+{
+    ShadowMode shadows = ShadowMode::none;
+    if (context != NULL) {
+        shadows = shadow_mode(context->shadow_rays, context->occluders != NULL);
+    }
+    select_integrator(USE_TEXTURES, shadows, false, track).trace(ray, pixel, reflections, context);
+}
+
+void render_tile(Camera *camera, const Tile &tile, vec3 *rgb, const RenderOptions &options)
+{
+    TilePacket packet;
+    if (options.packets) {
+        build_packet(camera, tile, packet);
+    }
+    const TilePacket *primary = options.packets ? &packet : NULL;
+
+    //this thread's cache, for this tile only
+    OccluderCache occluders = OccluderCache(scene_lights.size());
+    TraceContext context;
+    context.shadow_rays = options.shadow_rays;
+    context.occluders = options.occluder_cache ? &occluders : NULL;
+    context.irradiance = options.indirect ? &irradiance_cache : NULL;
+    context.photons = options.photons > 0 ? &photon_map : NULL;
+    context.max_reflections = options.reflections;
+    context.roulette = options.roulette;
+
+    //one lookup per tile, the kernel itself has no feature branches left
+    const Integrator &integrator = select_integrator(options);
+    if (options.sort_rays) {
+        integrator.render_sorted(camera, tile, rgb, primary, context);
+    }
+    else {
+        integrator.render_depth_first(camera, tile, rgb, primary, context);
+    }
+
+    OCCLUDER_LOOKUPS += occluders.lookups;
+    OCCLUDER_HITS += occluders.hits;
+}
+
+void render_guides(Camera *camera, const Tile &tile, GuideBuffers &guides)
+{
+    for (int j = tile.y0; j < tile.y1; j++) {
+        for (int i = tile.x0; i < tile.x1; i++) {
+            int p = j * guides.width + i;
+            Pixel pixel = Pixel(i, j, camera);
+            pixel.remap();
+            Ray ray = Ray(vec3(0.0), glm::normalize(vec3(pixel.x, pixel.y, -1.0)), RayType::camera);
+
+            HitRecord closest;
+            closest_hit(ray, closest);
+            guides.depth[p] = -1.0;
+            if (closest.object == NULL || closest.t == FLT_MAX) {
+                continue;
+            }
+            Object *obj = closest.object;
+            guides.depth[p] = closest.t;
+            if (obj->type == ObjType::light) {
+                guides.normal[p] = -ray.direction;
+                guides.albedo[p] = vec3(obj->color);
+                continue;
             }
+            SurfaceInteraction si;
+            obj->compute_surface_interaction(ray, closest, si);
+            guides.normal[p] = glm::dot(si.n, ray.direction) > 0.0 ? -si.n : si.n;
+            vec4 color = vec4(0.0);
+            surface_color<USE_TEXTURES>(obj, si, color);
+            guides.albedo[p] = vec3(color);
         }
     }
 }
 
-void tracer(Camera *camera)
+void write_tile(FIBITMAP *bitmap, Camera *camera, const Tile &tile, const vec3 *rgb)
 {
-    FreeImage_Initialise();
-    FIBITMAP* bitmap = FreeImage_Allocate(camera->width, camera->height, camera->bpp);
     RGBQUAD color;
+    for (int j = tile.y0; j < tile.y1; j++) {
+        for (int i = tile.x0; i < tile.x1; i++) {
+            vec3 rgb_color = rgb[(j - tile.y0) * tile.width() + (i - tile.x0)];
+            color.rgbRed = (double)(rgb_color.r * 255.0);
+            color.rgbGreen = (double)(rgb_color.g * 255.0);
+            color.rgbBlue = (double)(rgb_color.b * 255.0);
+            FreeImage_SetPixelColor(bitmap, i, camera->height - 1 - j, &color); //bitmaps are bottom up
+        }
+    }
+}
+
+void tracer(Camera *camera, const RenderOptions &options, ThreadPool &pool, const std::string &output)
+{
+    ScopedTimer trace(profiler, "trace");
+    FIBITMAP* bitmap = NULL;
+    StreamingImage *stream = NULL;
+    if (options.stream) {
+        //the coordinator is the only thread receiving tiles and gets them
+        //out of order, it must never block on the band window
+        stream = new StreamingImage(output, camera->width, camera->height, TILE_SIZE, STREAM_BANDS, options.workers <= 1);
+        if (!stream->is_open()) {
+            delete stream;
+            return;
+        }
+    }
+    else {
+        bitmap = FreeImage_Allocate(camera->width, camera->height, camera->bpp);
+        MemoryAccount::allocated(MemoryTag::framebuffer, FreeImage_GetDIBSize(bitmap));
+    }
 
-    for (int i = 0; i < camera->width; i++) {
-	    for (int j = 0; j < camera->height; j++) {
-			//base color
-            color.rgbRed = 0.0;
-	        color.rgbGreen = 0.0;
-	        color.rgbBlue = 0.0;
+    //tiles touch disjoint pixels, so threads can write the target directly
+    TileSink save = [&](const Tile &tile, const vec3 *rgb) {
+        if (stream) {
+            stream->write_tile(tile, rgb);
+        }
+        else {
+            ScopedTimer timer(profiler, "convert");
+            write_tile(bitmap, camera, tile, rgb);
+        }
+    };
 
-			//base pixel remapping
-			Pixel pixel = Pixel(i, j, camera);
-			pixel.remap();
-            pixel.set_color(vec4(0.0, 0.0, 0.0, 1.0));
+    //the denoiser needs the whole frame, tiles are held back until it ran
+    std::vector<vec3> frame;
+    if (options.denoise) {
+        frame.assign(camera->width * camera->height, vec3(0.0));
+    }
+    TileSink hold = [&](const Tile &tile, const vec3 *rgb) {
+        for (int j = tile.y0; j < tile.y1; j++) {
+            std::copy(rgb + (j - tile.y0) * tile.width(), rgb + (j - tile.y0 + 1) * tile.width(),
+                frame.begin() + j * camera->width + tile.x0);
+        }
+    };
+    TileSink sink = options.denoise ? hold : save;
 
-            vec3 direction = vec3(pixel.x, pixel.y, -1.0); //direction of negative z
-			direction = glm::normalize(direction);
-			vec3 origin = vec3(0.0);
+    //records and photons belong to this frame's poses
+    irradiance_cache.clear();
+    if (options.photons > 0) {
+        ScopedTimer timer(profiler, "photons");
+        emit_photons(options.photons, pool);
+    }
 
-			//initial camera ray
-            int reflections = 0;
-            Ray *ray = new Ray(origin, direction, RayType::camera);
+    std::vector<Tile> tiles = make_tiles(camera, TILE_SIZE);
+    profiler.begin("render");
+    if (options.workers > 1) {
+        //workers are forked after world_setup, so each has its own copy of the scene
+        TileCoordinator coordinator = TileCoordinator(options.workers, TILE_TIMEOUT);
+        coordinator.render(
+            tiles,
+            [camera, &options](const Tile &tile, vec3 *rgb) { render_tile(camera, tile, rgb, options); },
+            sink);
+        cout << "tiles reissued " << coordinator.reissued << " failed workers " << coordinator.failed_workers << endl;
+    }
+    else {
+        Profiler::Path path = profiler.path();
+        pool.parallel_for(tiles.size(), [&](int t) {
+            ScopedTimer timer(profiler, "tile", path);
+            profiler.annotate(t);
+            std::vector<vec3> rgb(tiles[t].size());
+            long rays = RAYS_CAST;
+            render_tile(camera, tiles[t], &rgb[0], options);
+            profiler.add_rays(RAYS_CAST - rays);
+            sink(tiles[t], &rgb[0]);
+        });
+    }
+    profiler.end();
 
-            bool track = false;
-            trace_ray(ray, pixel, reflections, track);
+    if (options.denoise) {
+        ScopedTimer timer(profiler, "denoise");
+        GuideBuffers guides;
+        guides.resize(camera->width, camera->height);
+        pool.parallel_for(tiles.size(), [&](int t) {
+            render_guides(camera, tiles[t], guides);
+        });
+        Denoiser denoiser;
+        denoiser.run(frame, guides, pool);
 
-            //draw pixel
-            vec3 rgb_color = pixel.convert_rgba_to_rgb(vec4(1.0));
-            color.rgbRed = (double)(rgb_color.r * 255.0);
-		    color.rgbGreen = (double)(rgb_color.g * 255.0);
-			color.rgbBlue = (double)(rgb_color.b * 255.0);
-			FreeImage_SetPixelColor(bitmap, i, camera->height-j, &color);
+        //in tile order, a streamed image fills its bands one after the other
+        std::vector<vec3> rgb;
+        for (unsigned int t = 0; t < tiles.size(); t++) {
+            const Tile &tile = tiles[t];
+            rgb.resize(tile.size());
+            for (int j = tile.y0; j < tile.y1; j++) {
+                std::copy(frame.begin() + j * camera->width + tile.x0, frame.begin() + j * camera->width + tile.x1,
+                    rgb.begin() + (j - tile.y0) * tile.width());
+            }
+            save(tile, &rgb[0]);
+        }
+    }
 
-            delete ray;
+    ScopedTimer timer(profiler, "save");
+    if (stream) {
+        if (stream->close()) {
+            cout << "Saved " << output << " (peak bands in memory " << stream->peak_bands << ")" << endl;
         }
+        delete stream;
     }
-    if (FreeImage_Save(FIF_PNG, bitmap, "./test/test.png", 0)) {
-		cout << "Saved!";
-	}
-	FreeImage_DeInitialise();
+    else {
+        if (FreeImage_Save(FIF_PNG, bitmap, output.c_str(), 0)) {
+            cout << "Saved " << output << endl;
+        }
+        MemoryAccount::released(MemoryTag::framebuffer, FreeImage_GetDIBSize(bitmap));
+        FreeImage_Unload(bitmap);
+    }
+}
+
+void animation_setup(Animation &animation)
+{
+    //objects[0] is the textured sphere, objects[1] the light
+    AnimationTrack &sphere = animation.track(objects[0]);
+    sphere.add_key(Keyframe(0.0, vec3(0.0, -0.75, -15.0)));
+    sphere.add_key(Keyframe(1.0, vec3(2.0, 0.5, -15.0), Keyframe::axis_angle(90.0, vec3(0.0, 1.0, 0.0))));
+    sphere.add_key(Keyframe(2.0, vec3(0.0, -0.75, -15.0), Keyframe::axis_angle(180.0, vec3(0.0, 1.0, 0.0))));
+
+    AnimationTrack &light = animation.track(objects[1]);
+    light.add_key(Keyframe(0.0, vec3(-2.0, 3.0, -13.0)));
+    light.add_key(Keyframe(2.0, vec3(2.0, 3.0, -13.0)));
+}
+
+void render_sequence(Camera *camera, Animation &animation, const RenderOptions &options, ThreadPool &pool)
+{
+    //scene, textures and pool stay alive across frames, only poses change
+    for (int f = 0; f < options.frames; f++) {
+        if (animation.apply(animation.frame_time(f))) {
+            scene_bvh.refit();
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "_%04d", f);
+        std::string output = options.output;
+        size_t dot = output.rfind('.');
+        output.insert(dot == std::string::npos ? output.size() : dot, name);
+        tracer(camera, options, pool, output);
+    }
+}
+
+void benchmark_kernels(Camera *camera)
+{
+    RandomStream rs = RandomStream(BENCH_SEED, 0, 0, 0, 0);
+    std::vector<Ray> rays;
+    rays.reserve(BENCH_RAYS);
+    for (int r = 0; r < BENCH_RAYS; r++) {
+        Pixel pixel = Pixel((int)(rs.next_float() * camera->width), (int)(rs.next_float() * camera->height), camera);
+        pixel.remap();
+        rays.push_back(Ray(vec3(0.0), glm::normalize(vec3(pixel.x, pixel.y, -1.0)), RayType::camera));
+    }
+
+    //results go somewhere so the loops can't be dropped
+    long hits = 0;
+    ScopedTimer bench(profiler, "bench");
+    {
+        //objects[0] is the textured sphere
+        ScopedTimer timer(profiler, "sphere");
+        float t;
+        int prim;
+        for (int r = 0; r < BENCH_RAYS; r++) {
+            hits += objects[0]->intersects(rays[r], 0.0f, FLT_MAX, t, prim);
+        }
+        profiler.add_rays(BENCH_RAYS);
+    }
+    {
+        ScopedTimer timer(profiler, "traversal");
+        for (int r = 0; r < BENCH_RAYS; r++) {
+            HitRecord closest;
+            closest_hit(rays[r], closest);
+            hits += closest.object != NULL;
+        }
+        profiler.add_rays(BENCH_RAYS);
+    }
+    if (objects[0]->has_texture) {
+        //a lookup counts as a ray
+        std::vector<float> uv(2 * BENCH_RAYS);
+        rs.next_floats(&uv[0], uv.size());
+        ScopedTimer timer(profiler, "texture");
+        vec3 rgb;
+        for (int r = 0; r < BENCH_RAYS; r++) {
+            hits += TextureManager::get_uv_pixel_color(rgb, objects[0]->texture_filepath, uv[2 * r], uv[2 * r + 1]);
+        }
+        profiler.add_rays(BENCH_RAYS);
+    }
+    cout << "bench hits " << hits << endl;
 }
 
 FIBITMAP* load_image (const std::string& imagepath, int flag) {
@@ -291,10 +1236,189 @@ int main(int argc, char* argv[])
     getchar();
     */
 
-    if (RUN_TEST) {
+    //rt --render [--workers N] [--threads N] [--frames N] [--instances N]
+    //   [--size WxH] [--stream] [--sort-rays] [--no-packets]
+    //   [--shadows] [--occluder-cache] [--indirect]
+    //   [--photons N] [--photon-memory MB] [--reflections N] [--roulette]
+    //   [--denoise] [--texture-memory MB] [--texture-cache DIR]
+    //   [--counters] [--bench] [--timeline FILE] [--generic]
+    //renders ./test/test.png (or a numbered sequence) instead of running the tests
+    //rt --check-kernels N
+    //runs N cases per primitive through the kernel variants and their references
+    bool render = false;
+    long check_cases = 0;
+    RenderOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--render") {
+            render = true;
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            options.frames = atoi(argv[++i]);
+        }
+        else if (arg == "--instances" && i + 1 < argc) {
+            options.instances = atoi(argv[++i]);
+        }
+        else if (arg == "--size" && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+        }
+        else if (arg == "--stream") {
+            options.stream = true;
+            options.output = "./test/test.ppm";
+        }
+        else if (arg == "--sort-rays") {
+            options.sort_rays = true;
+        }
+        else if (arg == "--no-packets") {
+            options.packets = false;
+        }
+        else if (arg == "--shadows") {
+            options.shadow_rays = true;
+        }
+        else if (arg == "--occluder-cache") {
+            options.occluder_cache = true;
+        }
+        else if (arg == "--indirect") {
+            options.indirect = true;
+        }
+        else if (arg == "--photons" && i + 1 < argc) {
+            options.photons = atol(argv[++i]);
+        }
+        else if (arg == "--photon-memory" && i + 1 < argc) {
+            options.photon_memory = (size_t)atol(argv[++i]) << 20;
+        }
+        else if (arg == "--reflections" && i + 1 < argc) {
+            options.reflections = atoi(argv[++i]);
+        }
+        else if (arg == "--roulette") {
+            options.roulette = true;
+        }
+        else if (arg == "--denoise") {
+            options.denoise = true;
+        }
+        else if (arg == "--texture-memory" && i + 1 < argc) {
+            options.texture_memory = (size_t)atol(argv[++i]) << 20;
+        }
+        else if (arg == "--texture-cache" && i + 1 < argc) {
+            options.texture_cache = argv[++i];
+        }
+        else if (arg == "--counters") {
+            options.counters = true;
+        }
+        else if (arg == "--bench") {
+            options.bench = true;
+            options.counters = true;
+        }
+        else if (arg == "--timeline" && i + 1 < argc) {
+            options.timeline = argv[++i];
+        }
+        else if (arg == "--generic") {
+            options.specialize = false;
+        }
+        else if (arg == "--check-kernels" && i + 1 < argc) {
+            check_cases = atol(argv[++i]);
+        }
+    }
+
+    if (check_cases > 0) {
+        KernelCheck check = KernelCheck(KERNEL_CHECK_SEED, KERNEL_CHECK_ULPS);
+        check.add_builtin();
+        std::vector<KernelCheck::Report> reports = check.run(check_cases);
+        KernelCheck::write_report(cout, reports);
+        for (unsigned int k = 0; k < reports.size(); k++) {
+            if (reports[k].mismatches > 0) return 1;
+        }
+        return 0;
+    }
+
+    if (RUN_TEST && !render) {
         ::testing::InitGoogleTest(&argc, argv);
         return RUN_ALL_TESTS();
     } else {
+        FreeImage_Initialise();
+        TextureManager::cache.set_budget(options.texture_memory);
+        TextureManager::cache.set_file_directory(options.texture_cache);
+        ThreadPool pool(options.threads);
+        profiler.use_counters(options.counters);
+        profiler.use_timeline(!options.timeline.empty());
+        profiler.reset();
+        Camera *camp;
+        {
+            ScopedTimer timer(profiler, "setup");
+            camp = world_setup(options, &pool);
+        }
+        photon_map = PhotonMap(options.photon_memory);
+        if (options.bench) {
+            benchmark_kernels(camp);
+        }
+        else if (options.frames > 1) {
+            Animation animation;
+            animation_setup(animation);
+            render_sequence(camp, animation, options, pool);
+        }
+        else {
+            tracer(camp, options, pool, options.output);
+        }
+        cout << endl << "hits " << HIT_COUNT << " total " << (camp->width * camp->height) << endl;
+        cout << "packet tiles " << PACKET_TILES << endl;
+        cout << "integrator " << integrator_name(options) << endl;
+        if (options.shadow_rays) {
+            cout << "shadow rays " << SHADOW_RAYS;
+            if (options.occluder_cache) {
+                long lookups = OCCLUDER_LOOKUPS;
+                cout << " occluder cache hits " << OCCLUDER_HITS << " of " << lookups;
+                if (lookups > 0) {
+                    cout << " (" << (100.0 * OCCLUDER_HITS / lookups) << "%)";
+                }
+            }
+            cout << endl;
+        }
+        if (options.indirect) {
+            cout << "irradiance lookups " << IRRADIANCE_LOOKUPS << " records " << irradiance_cache.size() << endl;
+        }
+        if (options.roulette) {
+            cout << "roulette ended " << ROULETTE_KILLED << " paths, " << ROULETTE_SURVIVED << " survived" << endl;
+        }
+        if (options.photons > 0) {
+            cout << "photons emitted " << options.photons << " stored " << photon_map.size() << " of "
+                << photon_map.capacity() << " (" << (photon_map.bytes() >> 20) << " MB)" << endl;
+        }
+        if (TextureManager::cache.hits + TextureManager::cache.misses > 0) {
+            TextureCache &textures = TextureManager::cache;
+            cout << "texture pages hits " << textures.hits << " misses " << textures.misses
+                << " evictions " << textures.evictions << " decodes " << textures.decodes
+                << " from files " << textures.mapped
+                << " resident " << (textures.resident_bytes() >> 10) << " KB" << endl;
+        }
+
+        //beside the image, ./test/test.png reports to ./test/test.profile.json
+        std::string report = options.output;
+        size_t dot = report.rfind('.');
+        if (dot != std::string::npos && dot > report.rfind('/') + 1) {
+            report.erase(dot);
+        }
+        report += ".profile.json";
+        cout << endl;
+        profiler.write_text(cout);
+        std::ofstream json(report.c_str());
+        profiler.write_json(json);
+        if (!options.timeline.empty()) {
+            std::ofstream trace(options.timeline.c_str());
+            profiler.write_timeline(trace);
+            cout << "timeline written to " << options.timeline << endl;
+        }
+        world_teardown(camp);
+        TextureManager::cache.clear();
+        //anything still charged after teardown is a leak
+        cout << endl;
+        MemoryAccount::write_report(cout);
+        FreeImage_DeInitialise();
         return 0;
     }
 }
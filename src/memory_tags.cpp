@@ -0,0 +1,55 @@
+#include "src/memory_tags.hpp"
+#include <cstdio>
+
+//static
+std::atomic<long> MemoryAccount::current_bytes[(int)MemoryTag::COUNT];
+std::atomic<long> MemoryAccount::peak_bytes[(int)MemoryTag::COUNT];
+
+//static
+void MemoryAccount::allocated(MemoryTag tag, size_t bytes) {
+    long now = current_bytes[(int)tag].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    long peak = peak_bytes[(int)tag].load(std::memory_order_relaxed);
+    while (now > peak && !peak_bytes[(int)tag].compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+//static
+void MemoryAccount::released(MemoryTag tag, size_t bytes) {
+    current_bytes[(int)tag].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+//static
+long MemoryAccount::current(MemoryTag tag) {
+    return current_bytes[(int)tag];
+}
+
+//static
+long MemoryAccount::peak(MemoryTag tag) {
+    return peak_bytes[(int)tag];
+}
+
+//static
+void MemoryAccount::reset_peaks() {
+    for (int t = 0; t < (int)MemoryTag::COUNT; t++) {
+        peak_bytes[t] = current_bytes[t].load();
+    }
+}
+
+//static
+const char* MemoryAccount::name(MemoryTag tag) {
+    static const char *names[(int)MemoryTag::COUNT] = {"scene", "bvh", "textures", "framebuffer", "tracker", "rays"};
+    return names[(int)tag];
+}
+
+//static
+void MemoryAccount::write_report(std::ostream &out) {
+    char line[128];
+    snprintf(line, sizeof(line), "%-12s %14s %14s", "memory", "current KB", "peak KB");
+    out << line << "\n";
+    for (int t = 0; t < (int)MemoryTag::COUNT; t++) {
+        snprintf(line, sizeof(line), "%-12s %14.1f %14.1f", name((MemoryTag)t),
+            current((MemoryTag)t) / 1024.0, peak((MemoryTag)t) / 1024.0);
+        out << line << "\n";
+    }
+    out.flush();
+}
@@ -2,6 +2,7 @@
 #include "src/variables.h"
 #include "src/transform.h"
 #include <iostream>
+#include <cfloat>
 
 //static member definition
 int Object::id_generator = 0;
@@ -39,6 +40,33 @@ Object::Object (mat4 *otw, vec4 col, float ease_dist, int new_id) {
     easing_distance = ease_dist;
 }
 
+//fallback for objects without their own interval test
+bool Object::intersects (const Ray &ray, float tmin, float tmax, float &t, int &prim) {
+    vec3 hit, n;
+    float t0, t1;
+    if (!intersects(ray, hit, n, t0, t1)) return false;
+    t0 = glm::abs(t0);
+    if (t0 < tmin || t0 >= tmax) return false;
+    t = t0;
+    prim = 0;
+    return true;
+}
+
+//fallback, redoes the full intersection
+void Object::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+    float t0, t1;
+    intersects(ray, si.position, si.n, t0, t1);
+}
+
+AABB Object::get_bounds () {
+    return AABB::infinite();
+}
+
+void Object::set_transform (const mat4 &otw) {
+    objectToWorld = otw;
+    worldToObject = glm::inverse(objectToWorld);
+}
+
 //Uses Object constructor by passing it parameters //superclass constructor executes first
 Sphere::Sphere (float r, mat4 *otw, vec4 col, float ease_dist) : Object(otw, col, ease_dist) {
 	type = ObjType::sphere;
@@ -76,18 +104,13 @@ Sphere::Sphere (const Sphere& source) {
 }
 
 bool Sphere::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t1) {
-    int method = 1;
+    const int method = 1; //2 is the quadratic, folded away at compile time
     if (method == 1) {
         vec3 SC = vec3(center.x, center.y, center.z); //ignore w here for now
         vec3 RD = glm::normalize(ray.direction); //should always be a normal
         float SR2 = radius * radius;
         vec3 OC = SC - ray.origin;
         float L2OC = glm::dot(OC, OC);
-        std::cout << "SC " << SC << std::endl;
-        std::cout << "RD " << RD << std::endl;
-        std::cout << "SR2 " << SR2 << std::endl;
-        std::cout << "OC " << OC << std::endl;
-        std::cout << "L2OC " << L2OC << std::endl;
 
         float t_ca = glm::dot(OC, RD);
         //sphere located behind ray origin
@@ -103,9 +126,6 @@ bool Sphere::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t
 	    float T2HC = SR2 - D2;
         if (T2HC < 0) return false;
 
-        std::cout << "T_CA " << t_ca << std::endl;
-        std::cout << "D2 " << D2 << std::endl;
-        std::cout << "T2HC " << T2HC << std::endl;
         //if the origin is inside the sphere of light, it counts as a hit
         if (L2OC < SR2) {
             t0 = 0.0;
@@ -118,7 +138,6 @@ bool Sphere::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t
         float THC = sqrt(T2HC);
         t0 = t_ca - THC; //distance to point of impact
 	    t1 = t_ca + THC; //distance to other side of sphere
-        std::cout << "THC " << THC << std::endl;
 
         float dist = easing_distance * t0;
 	    hit = ray.origin + (dist * RD);
@@ -156,6 +175,62 @@ bool Sphere::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t
     return false;
 }
 
+bool Sphere::intersects (const Ray &ray, float tmin, float tmax, float &t, int &prim) {
+    vec3 SC = vec3(center.x, center.y, center.z);
+    vec3 RD = glm::normalize(ray.direction);
+    vec3 OC = SC - ray.origin;
+    float t_ca = glm::dot(OC, RD);
+    //sphere located behind ray origin
+    if (t_ca < 0) return false;
+    //the near side can't be closer than t_ca - radius
+    if (t_ca - radius >= tmax) return false;
+
+    float SR2 = radius * radius;
+    float L2OC = glm::dot(OC, OC);
+    float D2 = L2OC - pow(t_ca, 2);
+    if (D2 > SR2) return false;
+
+    //origin inside the sphere counts as a hit at the origin
+    //the root is rounded to float before the subtraction, like the reference
+    //does, or an origin on the surface can land just behind it and miss
+    float THC = sqrt(SR2 - D2);
+    float t0 = (L2OC < SR2) ? 0.0f : t_ca - THC;
+    //written so a NaN from a degenerate ray misses
+    if (!(t0 >= tmin && t0 < tmax)) return false;
+    t = t0;
+    prim = 0;
+    return true;
+}
+
+void Sphere::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+    vec3 SC = vec3(center.x, center.y, center.z);
+    vec3 OC = SC - ray.origin;
+    if (glm::dot(OC, OC) < radius * radius) {
+        //origin inside the sphere
+        si.position = ray.origin;
+        si.n = (float)-1.0 * OC;
+    }
+    else {
+        float dist = easing_distance * rec.t;
+        si.position = ray.origin + (dist * glm::normalize(ray.direction));
+        si.n = (si.position - SC) / (float)radius;
+    }
+
+    if (has_texture) {
+        get_uv(si.n, si.u, si.v);
+    }
+}
+
+AABB Sphere::get_bounds () {
+    vec3 c = vec3(center.x, center.y, center.z);
+    return AABB(c - vec3(radius), c + vec3(radius));
+}
+
+void Sphere::set_transform (const mat4 &otw) {
+    Object::set_transform(otw);
+    center = objectToWorld * vec4(0.0, 0.0, 0.0, 1.0);
+}
+
 float Sphere::get_phi (const vec3& n) {
     return glm::acos(glm::dot(((float)-1.0 * n), pole));
     //return glm::acos(glm::dot(n, pole));
@@ -207,7 +282,7 @@ bool Light::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t1
 		return true;
 	}
     else if (ltype == LightType::point) {
-	    int method = 1;
+	    const int method = 1;
         if (method == 1) {
             vec3 SC = vec3(center.x, center.y, center.z); //ignore w here for now
             float SR2 = radius * radius;
@@ -282,6 +357,65 @@ bool Light::intersects (const Ray &ray, vec3 &hit, vec3 &n, float &t0, float &t1
     return false;
 }
 
+bool Light::intersects (const Ray &ray, float tmin, float tmax, float &t, int &prim) {
+    prim = 0;
+    if (ltype == LightType::ambient) {
+        //reachable unless something is in the way, so it sits as far out as possible
+        if (FLT_MAX < tmin || FLT_MAX >= tmax) return false;
+        t = FLT_MAX;
+        return true;
+    }
+    else if (ltype != LightType::point) {
+        return false;
+    }
+
+    //point lights are spheres, same test as Sphere
+    vec3 SC = vec3(center.x, center.y, center.z);
+    vec3 RD = glm::normalize(ray.direction);
+    vec3 OC = SC - ray.origin;
+    float t_ca = glm::dot(OC, RD);
+    if (t_ca < 0) return false;
+    if (t_ca - radius >= tmax) return false;
+
+    float SR2 = radius * radius;
+    float L2OC = glm::dot(OC, OC);
+    float D2 = L2OC - pow(t_ca, 2);
+    if (D2 > SR2) return false;
+
+    float THC = sqrt(SR2 - D2);
+    float t0 = (L2OC < SR2) ? 0.0f : t_ca - THC;
+    if (!(t0 >= tmin && t0 < tmax)) return false;
+    t = t0;
+    return true;
+}
+
+void Light::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+    if (ltype != LightType::point) {
+        //nothing to hit, face the ray
+        si.position = ray.origin;
+        si.n = -glm::normalize(ray.direction);
+        return;
+    }
+    vec3 SC = vec3(center.x, center.y, center.z);
+    float dist = easing_distance * rec.t;
+    si.position = ray.origin + (dist * glm::normalize(ray.direction));
+    si.n = (si.position - SC) / (float)radius;
+}
+
+AABB Light::get_bounds () {
+    //ambient and directional lights are reachable from everywhere
+    if (ltype != LightType::point) {
+        return AABB::infinite();
+    }
+    vec3 c = vec3(center.x, center.y, center.z);
+    return AABB(c - vec3(radius), c + vec3(radius));
+}
+
+void Light::set_transform (const mat4 &otw) {
+    Object::set_transform(otw);
+    center = objectToWorld * vec4(0.0, 0.0, 0.0, 1.0);
+}
+
 Triangle::Triangle(vec3 A, vec3 B, vec3 C, vec4 col) {
 	v0 = A;
 	v1 = B;
@@ -294,8 +428,8 @@ Triangle::Triangle(vec3 A, vec3 B, vec3 C, vec4 col) {
 bool Triangle::intersects (const Ray &ray, vec3 &hit, vec3 &n_vec, float &t0, float &t1) {
 	//first test if ray intersects the plane in whicht the triangle lives
 	vec3 p0 = ray.origin;
-	vec3 p1 = ray.direction;
-	float denominator = glm::dot(n, p1 - p0);
+	vec3 rd = glm::normalize(ray.direction);
+	float denominator = glm::dot(n, rd);
 	if (denominator == 0) {
 		return false; //ray is in plane or parallel to plane
 	}
@@ -306,7 +440,7 @@ bool Triangle::intersects (const Ray &ray, vec3 &hit, vec3 &n_vec, float &t0, fl
 	}
 
 	//Now need to find if intersection point is in triangle (that's in the plane)
-	vec3 point_at_dist = p0 + dist * (p1 - p0);
+	vec3 point_at_dist = p0 + dist * rd;
 
 	//Point = v0 + s(v1-v0) + t(v2-v0) find s and t
 	//point exists if s>=0; t>=0; s+t<=1;
@@ -323,7 +457,7 @@ bool Triangle::intersects (const Ray &ray, vec3 &hit, vec3 &n_vec, float &t0, fl
 	if (s >= 0 && t >= 0 && s+t <= 1){
 		t0 = dist;
 		float eased_dist = glm::abs(dist) * 0.99;
-		hit = p0 + eased_dist * (p1 - p0);
+		hit = p0 + eased_dist * rd;
         n_vec = n;
 		return true;
 	}
@@ -331,6 +465,49 @@ bool Triangle::intersects (const Ray &ray, vec3 &hit, vec3 &n_vec, float &t0, fl
 	return false;
 };
 
+bool Triangle::intersects (const Ray &ray, float tmin, float tmax, float &t_out, int &prim) {
+	//distances along the normalized direction, like every other object
+	vec3 p0 = ray.origin;
+	vec3 rd = glm::normalize(ray.direction);
+	float denominator = glm::dot(n, rd);
+	if (denominator == 0) return false;
+	float dist = glm::dot(n, v0 - p0) / denominator;
+	//reject on distance before the inside test
+	if (!(dist >= 0 && dist >= tmin && dist < tmax)) return false;
+
+	vec3 w = p0 + dist * rd - v0;
+	vec3 u = v1 - v0;
+	vec3 v = v2 - v0;
+	float uv = glm::dot(u, v);
+	float uu = glm::dot(u, u);
+	float vv = glm::dot(v, v);
+	float wu = glm::dot(w, u);
+	float wv = glm::dot(w, v);
+	float st_denom = (uv * uv) - (uu * vv);
+	float s = ((uv * wv) - (vv * wu)) / st_denom;
+	float t = ((uv * wu) - (uu * wv)) / st_denom;
+	//a degenerate triangle gives NaN here, which has to miss
+	if (!(s >= 0 && t >= 0 && s + t <= 1)) return false;
+
+	t_out = dist;
+	prim = 0;
+	return true;
+}
+
+void Triangle::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+	float eased_dist = glm::abs(rec.t) * 0.99;
+	si.position = ray.origin + eased_dist * glm::normalize(ray.direction);
+	si.n = n;
+}
+
+AABB Triangle::get_bounds () {
+    AABB box;
+    box.extend(v0);
+    box.extend(v1);
+    box.extend(v2);
+    return box;
+}
+
 Plane::Plane(vec3 n_vec, float dist, vec4 col, float ease_dist) {
     D = dist;
     n = n_vec;
@@ -362,6 +539,25 @@ bool Plane::intersects (const Ray &ray, vec3 &hit, vec3 &n_vec, float &t0, float
     return true;
 }
 
+bool Plane::intersects (const Ray &ray, float tmin, float tmax, float &t, int &prim) {
+    vec3 rd = glm::normalize(ray.direction);
+    float vd = glm::dot(n, rd);
+    if (vd == 0) return false;
+
+    float t0 = -(glm::dot(n, ray.origin) + D) / vd;
+    //also rejects planes behind the origin when tmin >= 0, and NaN
+    if (!(t0 >= tmin && t0 < tmax)) return false;
+    t = t0;
+    prim = 0;
+    return true;
+}
+
+void Plane::compute_surface_interaction (const Ray &ray, const HitRecord &rec, SurfaceInteraction &si) {
+    float dist = easing_distance * glm::abs(rec.t);
+    si.position = ray.origin + (dist * glm::normalize(ray.direction));
+    si.n = n;
+}
+
 /*
 void Plane::project_to_uv (std::vector<vec3> points) {
     float x = glm::abs(n.x);
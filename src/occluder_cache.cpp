@@ -0,0 +1,11 @@
+#include "src/occluder_cache.hpp"
+
+OccluderCache::OccluderCache(int lights) {
+    last.assign(lights, NULL);
+}
+
+void OccluderCache::clear() {
+    last.assign(last.size(), NULL);
+    lookups = 0;
+    hits = 0;
+}
@@ -0,0 +1,100 @@
+#include "src/perf_counters.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static long _perf_event_open(perf_event_attr *attr, int group) {
+    //this thread, any cpu
+    return syscall(__NR_perf_event_open, attr, 0, -1, group, 0);
+}
+
+static uint64_t _cache_event(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+PerfCounters::PerfCounters() {
+    const uint32_t types[EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+    };
+    const uint64_t configs[EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        _cache_event(PERF_COUNT_HW_CACHE_L1D), _cache_event(PERF_COUNT_HW_CACHE_LL),
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (int e = 0; e < EVENTS; e++) {
+        fds[e] = -1;
+        slot[e] = -1;
+
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[e];
+        attr.config = configs[e];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = leader < 0; //the leader starts the whole group
+
+        long fd = _perf_event_open(&attr, leader);
+        if (fd < 0) {
+            if (failure.empty()) {
+                failure = std::string(name(e)) + ": " + strerror(errno);
+            }
+            continue;
+        }
+        fds[e] = fd;
+        slot[e] = members++;
+        if (leader < 0) {
+            leader = fd;
+        }
+    }
+
+    if (leader >= 0) {
+        failure.clear();
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int e = 0; e < EVENTS; e++) {
+        if (fds[e] >= 0) close(fds[e]);
+    }
+}
+
+void PerfCounters::read(Reading &out) const {
+    out = Reading();
+    if (leader < 0) return;
+
+    //nr, time enabled, time running, then one value per member
+    uint64_t buf[3 + EVENTS];
+    if (::read(leader, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t))) return;
+    out.enabled = buf[1];
+    out.running = buf[2];
+    for (int e = 0; e < EVENTS; e++) {
+        if (slot[e] >= 0 && (uint64_t)slot[e] < buf[0]) {
+            out.values[e] = buf[3 + slot[e]];
+        }
+    }
+}
+
+//static
+void PerfCounters::difference(const Reading &start, const Reading &end, uint64_t out[EVENTS]) {
+    uint64_t enabled = end.enabled > start.enabled ? end.enabled - start.enabled : 0;
+    uint64_t running = end.running > start.running ? end.running - start.running : 0;
+    double scale = (running > 0 && running < enabled) ? (double)enabled / running : 1.0;
+    for (int e = 0; e < EVENTS; e++) {
+        uint64_t counted = end.values[e] > start.values[e] ? end.values[e] - start.values[e] : 0;
+        out[e] = (uint64_t)(counted * scale);
+    }
+}
+
+//static
+const char* PerfCounters::name(int event) {
+    static const char *names[EVENTS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+    return names[event];
+}
@@ -0,0 +1,240 @@
+#include "src/photon_map.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+static const float PI = M_PI;
+
+//static
+Photon Photon::pack(const vec3 &position, const vec3 &power, const vec3 &direction) {
+    Photon photon;
+    photon.position[0] = position.x;
+    photon.position[1] = position.y;
+    photon.position[2] = position.z;
+    photon.set_power(power);
+
+    float z = std::max(-1.0f, std::min(1.0f, direction.z));
+    int theta = (int)(acos(z) * (256.0 / PI));
+    int phi = (int)(atan2(direction.y, direction.x) * (256.0 / (2.0 * PI)));
+    photon.theta = (unsigned char)std::min(theta, 255);
+    photon.phi = (unsigned char)(phi < 0 ? phi + 256 : std::min(phi, 255));
+    photon.axis = 0;
+    return photon;
+}
+
+vec3 Photon::get_power() const {
+    if (power[3] == 0) return vec3(0.0);
+    float f = ldexp(1.0, (int)power[3] - (128 + 8));
+    return vec3(power[0] + 0.5f, power[1] + 0.5f, power[2] + 0.5f) * f;
+}
+
+void Photon::set_power(const vec3 &rgb) {
+    //Ward's rgbe, the largest channel sets the shared exponent
+    float v = std::max(rgb.r, std::max(rgb.g, rgb.b));
+    if (v < 1e-32) {
+        power[0] = power[1] = power[2] = power[3] = 0;
+    }
+    else {
+        int e;
+        float m = frexp(v, &e) * 256.0 / v;
+        power[0] = (unsigned char)(rgb.r * m);
+        power[1] = (unsigned char)(rgb.g * m);
+        power[2] = (unsigned char)(rgb.b * m);
+        power[3] = (unsigned char)(e + 128);
+    }
+}
+
+vec3 Photon::get_direction() const {
+    //bucket centres
+    float t = (theta + 0.5f) * (PI / 256.0f);
+    float p = (phi + 0.5f) * (2.0f * PI / 256.0f);
+    return vec3(std::sin(t) * std::cos(p), std::sin(t) * std::sin(p), std::cos(t));
+}
+
+PhotonMap::PhotonMap(size_t budget_bytes) {
+    max_photons = budget_bytes / (2 * sizeof(Photon));
+}
+
+void PhotonMap::clear() {
+    //give the memory back, the next frame may shoot fewer
+    std::vector<Photon>().swap(tree);
+}
+
+//static
+size_t PhotonMap::left_size(size_t n) {
+    //a left-balanced tree of n nodes fills every level but the last, which
+    //fills from the left
+    if (n <= 1) return 0;
+    size_t full = 1;
+    while (2 * full <= n) full *= 2;
+    size_t last = n - (full - 1); //nodes on the last level
+    return (full / 2 - 1) + std::min(last, full / 2);
+}
+
+void PhotonMap::split(std::vector<Photon> &photons, const Range &range, Range &left, Range &right) {
+    //split along the widest extent of the range
+    vec3 lo = vec3(INFINITY), hi = vec3(-INFINITY);
+    for (size_t i = range.begin; i < range.end; i++) {
+        lo = glm::min(lo, photons[i].get_position());
+        hi = glm::max(hi, photons[i].get_position());
+    }
+    vec3 extent = hi - lo;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    size_t median = range.begin + left_size(range.end - range.begin);
+    std::nth_element(photons.begin() + range.begin, photons.begin() + median, photons.begin() + range.end,
+        [axis](const Photon &a, const Photon &b) { return a.position[axis] < b.position[axis]; });
+
+    tree[range.node] = photons[median];
+    tree[range.node].axis = axis;
+    left.begin = range.begin;
+    left.end = median;
+    left.node = 2 * range.node + 1;
+    right.begin = median + 1;
+    right.end = range.end;
+    right.node = 2 * range.node + 2;
+}
+
+void PhotonMap::build_range(std::vector<Photon> &photons, const Range &range) {
+    if (range.begin >= range.end) return;
+    Range left, right;
+    split(photons, range, left, right);
+    build_range(photons, left);
+    build_range(photons, right);
+}
+
+void PhotonMap::build(std::vector<Photon> &photons, ThreadPool &pool) {
+    if (photons.size() > max_photons) {
+        photons.resize(max_photons);
+    }
+    tree.assign(photons.size(), Photon());
+    if (photons.empty()) return;
+
+    //split breadth first until there's a few subtrees per thread
+    std::vector<Range> level(1);
+    level[0].begin = 0;
+    level[0].end = photons.size();
+    level[0].node = 0;
+    unsigned int wanted = pool.size() * 4;
+    while (level.size() < wanted && level.size() < photons.size()) {
+        std::vector<Range> next;
+        for (unsigned int i = 0; i < level.size(); i++) {
+            if (level[i].begin >= level[i].end) continue;
+            Range left, right;
+            split(photons, level[i], left, right);
+            next.push_back(left);
+            next.push_back(right);
+        }
+        if (next.empty()) break;
+        level.swap(next);
+    }
+
+    //subtrees cover disjoint slices of the input and disjoint nodes
+    pool.parallel_for(level.size(), [&](int i) {
+        build_range(photons, level[i]);
+    });
+}
+
+void PhotonMap::search(size_t node, const vec3 &p, int k, float &max_dist2, std::vector<Candidate> &heap) const {
+    const Photon &photon = tree[node];
+    float plane = p[photon.axis] - photon.position[photon.axis];
+    size_t left = 2 * node + 1;
+    if (left < tree.size()) {
+        //near side first, the far side only while the plane is close enough
+        size_t near = plane < 0.0 ? left : left + 1;
+        size_t far = plane < 0.0 ? left + 1 : left;
+        if (near < tree.size()) search(near, p, k, max_dist2, heap);
+        if (plane * plane < max_dist2 && far < tree.size()) search(far, p, k, max_dist2, heap);
+    }
+
+    vec3 d = photon.get_position() - p;
+    float dist2 = glm::dot(d, d);
+    if (dist2 >= max_dist2) return;
+
+    //max heap on distance, once full the farthest is replaced
+    if ((int)heap.size() == k) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+    }
+    heap.push_back(Candidate(dist2, node));
+    std::push_heap(heap.begin(), heap.end());
+    if ((int)heap.size() == k) {
+        max_dist2 = heap.front().first;
+    }
+}
+
+void PhotonMap::nearest(const vec3 &p, int k, float max_radius, std::vector<int> &found) const {
+    found.clear();
+    if (tree.empty() || k <= 0) return;
+    std::vector<Candidate> heap;
+    heap.reserve(k);
+    float max_dist2 = max_radius * max_radius;
+    search(0, p, k, max_dist2, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    for (unsigned int i = 0; i < heap.size(); i++) {
+        found.push_back(heap[i].second);
+    }
+}
+
+vec3 PhotonMap::estimate(const vec3 &p, const vec3 &n, int k, float max_radius, std::vector<Candidate> &heap) const {
+    heap.clear();
+    if (tree.empty() || k <= 0) return vec3(0.0);
+    float max_dist2 = max_radius * max_radius;
+    search(0, p, k, max_dist2, heap);
+    if (heap.empty()) return vec3(0.0);
+
+    vec3 power = vec3(0.0);
+    for (unsigned int i = 0; i < heap.size(); i++) {
+        const Photon &photon = tree[heap[i].second];
+        if (glm::dot(photon.get_direction(), n) < 0.0) {
+            power += photon.get_power();
+        }
+    }
+    //max_dist2 shrank to the k-th distance if the heap filled up
+    return power / (PI * max_dist2);
+}
+
+vec3 PhotonMap::irradiance(const vec3 &p, const vec3 &n, int k, float max_radius) const {
+    std::vector<Candidate> heap;
+    heap.reserve(k);
+    return estimate(p, n, k, max_radius, heap);
+}
+
+//spreads the low 10 bits of x out to every third bit
+static uint32_t _spread_bits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+void PhotonMap::irradiance_batch(const std::vector<PhotonQuery> &queries, int k, float max_radius, std::vector<vec3> &out) const {
+    out.assign(queries.size(), vec3(0.0));
+    if (queries.empty() || tree.empty()) return;
+
+    //morton order over the queries' own bounds
+    vec3 lo = vec3(INFINITY), hi = vec3(-INFINITY);
+    for (unsigned int i = 0; i < queries.size(); i++) {
+        lo = glm::min(lo, queries[i].position);
+        hi = glm::max(hi, queries[i].position);
+    }
+    vec3 scale = 1023.0f / glm::max(hi - lo, vec3(1e-6));
+    std::vector<std::pair<uint32_t, int> > order(queries.size());
+    for (unsigned int i = 0; i < queries.size(); i++) {
+        vec3 q = (queries[i].position - lo) * scale;
+        uint32_t key = (_spread_bits(q.x) << 2) | (_spread_bits(q.y) << 1) | _spread_bits(q.z);
+        order[i] = std::make_pair(key, (int)i);
+    }
+    std::sort(order.begin(), order.end());
+
+    //one heap for the whole batch
+    std::vector<Candidate> heap;
+    heap.reserve(k);
+    for (unsigned int i = 0; i < order.size(); i++) {
+        const PhotonQuery &query = queries[order[i].second];
+        out[order[i].second] = estimate(query.position, query.n, k, max_radius, heap);
+    }
+}
@@ -0,0 +1,449 @@
+#include "src/profiler.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+
+//this thread's profile in the profilers it has timed with, by profiler id
+//only a cache, a profiler's own thread list is what counts
+static thread_local std::vector<std::pair<uint64_t, void*> > _cached_profiles;
+static thread_local size_t _last_cached = 0;
+//bumped whenever a profiler id retires, a thread that sees it move drops its
+//cache so entries of reset or destroyed profilers don't pile up
+static std::atomic<uint64_t> _generation(0);
+static thread_local uint64_t _cached_generation = 0;
+static std::atomic<uint64_t> _next_id(1);
+//per thread, a long run keeps its first events rather than growing without end
+static const size_t TIMELINE_LIMIT = 1 << 20;
+
+Profiler::Profiler() {
+    id = _next_id++;
+    started = wall_now();
+    cpu_started = process_cpu_now();
+}
+
+Profiler::~Profiler() {
+    _generation++;
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        delete threads[t]->counters;
+        delete threads[t];
+    }
+}
+
+//static
+double Profiler::wall_now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//static
+double Profiler::cpu_now() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//static
+double Profiler::process_cpu_now() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+Profiler::ThreadProfile* Profiler::local() {
+    //nearly always the same profiler as last time
+    if (_last_cached < _cached_profiles.size() && _cached_profiles[_last_cached].first == id) {
+        return (ThreadProfile*)_cached_profiles[_last_cached].second;
+    }
+    if (_cached_generation != _generation) {
+        _cached_generation = _generation;
+        _cached_profiles.clear();
+    }
+    for (size_t c = 0; c < _cached_profiles.size(); c++) {
+        if (_cached_profiles[c].first == id) {
+            _last_cached = c;
+            return (ThreadProfile*)_cached_profiles[c].second;
+        }
+    }
+
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex);
+    //dropped from the cache but still live
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        if (threads[t]->owner == self) {
+            _last_cached = _cached_profiles.size();
+            _cached_profiles.push_back(std::make_pair(id, (void*)threads[t]));
+            return threads[t];
+        }
+    }
+    ThreadProfile *profile = new ThreadProfile();
+    profile->nodes.resize(1);
+    profile->nodes[0].name = "run";
+    profile->nodes[0].parent = -1;
+    profile->owner = self;
+    profile->index = threads.size();
+    profile->record = timeline;
+    if (counters) {
+        //counters count the thread that opens them, so this has to run here
+        profile->counters = new PerfCounters();
+        if (!profile->counters->available()) {
+            if (counter_failure.empty()) {
+                counter_failure = profile->counters->error();
+            }
+            delete profile->counters;
+            profile->counters = NULL;
+        }
+    }
+    threads.push_back(profile);
+    _last_cached = _cached_profiles.size();
+    _cached_profiles.push_back(std::make_pair(id, (void*)profile));
+    return profile;
+}
+
+//static
+int Profiler::child(ThreadProfile *profile, int parent, const char *name) {
+    const std::vector<int> &children = profile->nodes[parent].children;
+    for (unsigned int c = 0; c < children.size(); c++) {
+        const char *other = profile->nodes[children[c]].name;
+        if (other == name || strcmp(other, name) == 0) {
+            return children[c];
+        }
+    }
+    Node node;
+    node.name = name;
+    node.parent = parent;
+    profile->nodes.push_back(node);
+    int index = profile->nodes.size() - 1;
+    profile->nodes[parent].children.push_back(index);
+    return index;
+}
+
+void Profiler::open(const char *name, bool timed) {
+    ThreadProfile *profile = local();
+    int parent = profile->stack.empty() ? 0 : profile->stack.back().node;
+    Open entry;
+    entry.node = child(profile, parent, name);
+    entry.timed = timed;
+    entry.tag = -1;
+    profile->stack.push_back(entry);
+    if (timed) {
+        Node &node = profile->nodes[entry.node];
+        node.wall_start = wall_now();
+        node.cpu_start = cpu_now();
+        if (profile->counters != NULL) {
+            profile->counters->read(node.events_start);
+        }
+    }
+}
+
+void Profiler::begin(const char *name) {
+    open(name, true);
+}
+
+void Profiler::end() {
+    ThreadProfile *profile = local();
+    if (profile->stack.empty()) return;
+    Open entry = profile->stack.back();
+    profile->stack.pop_back();
+    if (entry.timed) {
+        Node &node = profile->nodes[entry.node];
+        node.calls++;
+        double now = wall_now();
+        node.wall += now - node.wall_start;
+        if (profile->record) {
+            if (profile->events.size() < TIMELINE_LIMIT) {
+                Event event;
+                event.name = node.name;
+                event.start = node.wall_start - started;
+                event.duration = now - node.wall_start;
+                event.depth = profile->stack.size();
+                event.tag = entry.tag;
+                profile->events.push_back(event);
+            }
+            else {
+                profile->dropped++;
+            }
+        }
+        node.cpu += cpu_now() - node.cpu_start;
+        if (profile->counters != NULL) {
+            PerfCounters::Reading now;
+            profile->counters->read(now);
+            uint64_t counted[PerfCounters::EVENTS];
+            PerfCounters::difference(node.events_start, now, counted);
+            for (int e = 0; e < PerfCounters::EVENTS; e++) {
+                node.events[e] += counted[e];
+            }
+        }
+    }
+}
+
+void Profiler::add_rays(long n) {
+    ThreadProfile *profile = local();
+    profile->nodes[profile->stack.empty() ? 0 : profile->stack.back().node].rays += n;
+}
+
+void Profiler::annotate(long tag) {
+    ThreadProfile *profile = local();
+    if (!profile->stack.empty()) {
+        profile->stack.back().tag = tag;
+    }
+}
+
+Profiler::Path Profiler::path() {
+    ThreadProfile *profile = local();
+    Path names;
+    for (unsigned int i = 0; i < profile->stack.size(); i++) {
+        names.push_back(profile->nodes[profile->stack[i].node].name);
+    }
+    return names;
+}
+
+void Profiler::use_counters(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = on;
+}
+
+std::string Profiler::counters_error() {
+    //a thread's profile is where counters get opened
+    local();
+    std::lock_guard<std::mutex> lock(mutex);
+    return counter_failure;
+}
+
+void Profiler::use_timeline(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timeline = on;
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        delete threads[t]->counters;
+        delete threads[t];
+    }
+    threads.clear();
+    counter_failure.clear();
+    //every thread's cached pointer is now stale
+    id = _next_id++;
+    _generation++;
+    started = wall_now();
+    cpu_started = process_cpu_now();
+}
+
+double Profiler::elapsed() const {
+    return wall_now() - started;
+}
+
+//static
+void Profiler::merge(const ThreadProfile *profile, int index, Summary &summary) {
+    const Node &node = profile->nodes[index];
+    summary.calls += node.calls;
+    summary.wall += node.wall;
+    summary.cpu += node.cpu;
+    summary.rays += node.rays;
+    for (int e = 0; e < PerfCounters::EVENTS; e++) {
+        summary.events[e] += node.events[e];
+    }
+    if (node.calls > 0) {
+        summary.threads++;
+    }
+    for (unsigned int c = 0; c < node.children.size(); c++) {
+        const char *name = profile->nodes[node.children[c]].name;
+        unsigned int s = 0;
+        while (s < summary.children.size() && strcmp(summary.children[s].name, name) != 0) s++;
+        if (s == summary.children.size()) {
+            summary.children.push_back(Summary());
+            summary.children.back().name = name;
+        }
+        merge(profile, node.children[c], summary.children[s]);
+    }
+}
+
+//a phase's rays include those of the phases inside it
+//static
+long Profiler::total_rays(Summary &summary) {
+    for (unsigned int c = 0; c < summary.children.size(); c++) {
+        summary.rays += total_rays(summary.children[c]);
+    }
+    return summary.rays;
+}
+
+Profiler::Summary Profiler::summarize() {
+    Summary root;
+    root.name = "run";
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        merge(threads[t], 0, root);
+    }
+    total_rays(root);
+    //the root is never opened, it spans the whole run and every thread
+    root.calls = 1;
+    root.wall = elapsed();
+    root.cpu = process_cpu_now() - cpu_started;
+    root.threads = 1;
+    return root;
+}
+
+static double _percent(double wall, double parent_wall, int threads) {
+    double span = parent_wall * (threads > 0 ? threads : 1);
+    return span > 0.0 ? 100.0 * wall / span : 0.0;
+}
+
+//static
+void Profiler::write_text(std::ostream &out, const Summary &node, double parent_wall, int depth) {
+    char line[160];
+    std::string name = std::string(depth * 2, ' ') + node.name;
+    snprintf(line, sizeof(line), "%-28s %8ld %10.4f %10.4f %7.1f%% %7d",
+        name.c_str(), node.calls, node.wall, node.cpu, _percent(node.wall, parent_wall, node.threads), node.threads);
+    out << line;
+    if (node.rays > 0 && node.wall > 0.0) {
+        //per second of the phase, not of the summed thread time
+        double span = node.wall / (node.threads > 0 ? node.threads : 1);
+        snprintf(line, sizeof(line), " %12ld %10.3f", node.rays, node.rays / span * 1e-6);
+        out << line;
+    }
+    out << "\n";
+    for (unsigned int c = 0; c < node.children.size(); c++) {
+        write_text(out, node.children[c], node.wall, depth + 1);
+    }
+}
+
+void Profiler::write_text(std::ostream &out) {
+    Summary root = summarize();
+    char header[160];
+    snprintf(header, sizeof(header), "%-28s %8s %10s %10s %8s %7s %12s %10s",
+        "phase", "calls", "wall s", "cpu s", "%", "threads", "rays", "Mrays/s");
+    out << header << "\n";
+    write_text(out, root, root.wall, 0);
+
+    if (counters) {
+        std::string error = counters_error();
+        if (!error.empty()) {
+            out << "hardware counters unavailable (" << error << ")\n";
+        }
+        else {
+            snprintf(header, sizeof(header), "%-28s %12s %10s %6s %10s %10s %10s",
+                "per ray", "cycles", "instr", "IPC", "L1d miss", "LLC miss", "br miss");
+            out << "\n" << header << "\n";
+            for (unsigned int c = 0; c < root.children.size(); c++) {
+                write_counters(out, root.children[c], 0);
+            }
+        }
+    }
+    out.flush();
+}
+
+//static
+void Profiler::write_counters(std::ostream &out, const Summary &node, int depth) {
+    //phases without rays (setup, save) have nothing to divide by
+    if (node.rays > 0) {
+        const uint64_t *e = node.events;
+        double rays = node.rays;
+        char line[160];
+        std::string name = std::string(depth * 2, ' ') + node.name;
+        snprintf(line, sizeof(line), "%-28s %12.1f %10.1f %6.2f %10.3f %10.3f %10.3f\n", name.c_str(),
+            e[PerfCounters::CYCLES] / rays, e[PerfCounters::INSTRUCTIONS] / rays,
+            e[PerfCounters::CYCLES] > 0 ? (double)e[PerfCounters::INSTRUCTIONS] / e[PerfCounters::CYCLES] : 0.0,
+            e[PerfCounters::L1D_MISSES] / rays, e[PerfCounters::LLC_MISSES] / rays,
+            e[PerfCounters::BRANCH_MISSES] / rays);
+        out << line;
+    }
+    for (unsigned int c = 0; c < node.children.size(); c++) {
+        write_counters(out, node.children[c], depth + 1);
+    }
+}
+
+void Profiler::write_json(std::ostream &out, const Summary &node, double parent_wall, int depth) {
+    std::string indent(depth * 2, ' ');
+    char fields[256];
+    double span = node.wall / (node.threads > 0 ? node.threads : 1);
+    snprintf(fields, sizeof(fields),
+        "\"calls\": %ld, \"wall\": %.6f, \"cpu\": %.6f, \"percent\": %.2f, \"threads\": %d, "
+        "\"rays\": %ld, \"rays_per_second\": %.1f",
+        node.calls, node.wall, node.cpu, _percent(node.wall, parent_wall, node.threads), node.threads,
+        node.rays, span > 0.0 ? node.rays / span : 0.0);
+    //names are literals from the source, nothing to escape
+    out << indent << "{\"name\": \"" << node.name << "\", " << fields;
+    if (counters && counter_failure.empty()) {
+        //totals, per ray is left to whoever reads the file
+        out << ", \"counters\": {";
+        for (int e = 0; e < PerfCounters::EVENTS; e++) {
+            out << (e == 0 ? "" : ", ") << "\"" << PerfCounters::name(e) << "\": " << node.events[e];
+        }
+        out << "}";
+    }
+    out << ", \"children\": [";
+    for (unsigned int c = 0; c < node.children.size(); c++) {
+        out << (c == 0 ? "\n" : ",\n");
+        write_json(out, node.children[c], node.wall, depth + 1);
+    }
+    if (!node.children.empty()) {
+        out << "\n" << indent;
+    }
+    out << "]}";
+}
+
+void Profiler::write_json(std::ostream &out) {
+    Summary root = summarize();
+    write_json(out, root, root.wall, 0);
+    out << "\n";
+    out.flush();
+}
+
+ScopedTimer::ScopedTimer(Profiler &p, const char *name) : profiler(p) {
+    opened = 1;
+    profiler.begin(name);
+}
+
+ScopedTimer::ScopedTimer(Profiler &p, const char *name, const Profiler::Path &parent) : profiler(p) {
+    //a thread already inside the parent, like the one that handed out the
+    //work and then joined in, nests as usual
+    opened = 1;
+    if (profiler.path() != parent) {
+        for (unsigned int i = 0; i < parent.size(); i++) {
+            profiler.open(parent[i], false);
+        }
+        opened += parent.size();
+    }
+    profiler.begin(name);
+}
+
+ScopedTimer::~ScopedTimer() {
+    for (int i = 0; i < opened; i++) {
+        profiler.end();
+    }
+}
+
+void Profiler::write_timeline(std::ostream &out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    char line[256];
+    long dropped = 0;
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        const ThreadProfile *profile = threads[t];
+        if (profile->events.empty()) continue;
+        dropped += profile->dropped;
+        snprintf(line, sizeof(line),
+            "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+            first ? "" : ",", profile->index, profile->index);
+        out << line;
+        first = false;
+        for (unsigned int e = 0; e < profile->events.size(); e++) {
+            const Event &event = profile->events[e];
+            //complete events in microseconds, nested spans stack by time alone
+            snprintf(line, sizeof(line),
+                ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"depth\": %d",
+                event.name, profile->index, event.start * 1e6, event.duration * 1e6, event.depth);
+            out << line;
+            if (event.tag >= 0) {
+                out << ", \"id\": " << event.tag;
+            }
+            out << "}}";
+        }
+    }
+    out << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+    out.flush();
+}
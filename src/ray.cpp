@@ -1,7 +1,7 @@
 #include "src/ray.h"
 #include <iostream>
 
-int Ray::id_generator = 0;
+std::atomic<int> Ray::id_generator(0);
 
 Ray::Ray(vec3 orig, vec3 dir, RayType rt) {
     id = id_generator++;
@@ -24,6 +24,7 @@ Ray::Ray(const Ray& source) {
 	origin = source.origin;
 	direction = source.direction;
 	type = source.type;
+    throughput = source.throughput;
 };
 
 //calling rayinst(t) returns a point on this ray at some distance t
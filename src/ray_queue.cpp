@@ -0,0 +1,86 @@
+#include "src/ray_queue.hpp"
+
+//spreads the low 8 bits of x so there are two zero bits between each
+static uint32_t _spread_bits(uint32_t x) {
+    x &= 0xff;
+    x = (x | (x << 8)) & 0x0000f00f;
+    x = (x | (x << 4)) & 0x000c30c3;
+    x = (x | (x << 2)) & 0x00249249;
+    return x;
+}
+
+static uint32_t _cell(float value, float lo, float extent) {
+    const int cells = 1 << RayQueue::CELL_BITS;
+    if (extent <= 0.0f) return 0;
+    int c = (int)((value - lo) / extent * cells);
+    if (c < 0) return 0;
+    if (c >= cells) return cells - 1;
+    return c;
+}
+
+//static
+uint32_t RayQueue::coherence_key(const vec3 &origin, const vec3 &dir, const AABB &bounds) {
+    uint32_t octant = (dir.x < 0.0f ? 1 : 0) | (dir.y < 0.0f ? 2 : 0) | (dir.z < 0.0f ? 4 : 0);
+    vec3 extent = bounds.max - bounds.min;
+    uint32_t cx = _cell(origin.x, bounds.min.x, extent.x);
+    uint32_t cy = _cell(origin.y, bounds.min.y, extent.y);
+    uint32_t cz = _cell(origin.z, bounds.min.z, extent.z);
+    uint32_t morton = _spread_bits(cx) | (_spread_bits(cy) << 1) | (_spread_bits(cz) << 2);
+    return (octant << (3 * CELL_BITS)) | morton;
+}
+
+//static
+void RayQueue::radix_sort(std::vector<uint32_t> &keys, std::vector<int> &values) {
+    unsigned int n = keys.size();
+    std::vector<uint32_t> tmp_keys(n);
+    std::vector<int> tmp_values(n);
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        unsigned int count[256] = {0};
+        for (unsigned int i = 0; i < n; i++) {
+            count[(keys[i] >> shift) & 0xff]++;
+        }
+        //every key has the same digit, nothing moves in this pass
+        if (count[(keys[0] >> shift) & 0xff] == n) continue;
+
+        unsigned int offset = 0;
+        for (int d = 0; d < 256; d++) {
+            unsigned int c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int dst = count[(keys[i] >> shift) & 0xff]++;
+            tmp_keys[dst] = keys[i];
+            tmp_values[dst] = values[i];
+        }
+        keys.swap(tmp_keys);
+        values.swap(tmp_values);
+    }
+}
+
+void RayQueue::sort() {
+    unsigned int n = rays.size();
+    if (n < 2) return;
+
+    //cells are relative to this batch, so the key resolution follows the rays
+    AABB bounds;
+    for (unsigned int i = 0; i < n; i++) {
+        bounds.extend(rays[i].origin);
+    }
+
+    keys.resize(n);
+    order.resize(n);
+    for (unsigned int i = 0; i < n; i++) {
+        keys[i] = coherence_key(rays[i].origin, rays[i].direction, bounds);
+        order[i] = i;
+    }
+    radix_sort(keys, order);
+
+    //sort small keys, then move each ray once
+    scratch.resize(n);
+    for (unsigned int i = 0; i < n; i++) {
+        scratch[i] = rays[order[i]];
+    }
+    rays.swap(scratch);
+}
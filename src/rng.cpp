@@ -0,0 +1,130 @@
+#include "src/rng.hpp"
+
+//Philox multipliers and Weyl key increments
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+//the low 24 bits of the last counter word count blocks within a stream
+static const uint32_t BLOCK_MASK = 0x00FFFFFF;
+
+//static
+void Philox::generate(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t x0 = ctr[0], x1 = ctr[1], x2 = ctr[2], x3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int r = 0; r < ROUNDS; ++r) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * x0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * x2;
+        uint32_t y0 = (uint32_t)(p1 >> 32) ^ x1 ^ k0;
+        uint32_t y1 = (uint32_t)p1;
+        uint32_t y2 = (uint32_t)(p0 >> 32) ^ x3 ^ k1;
+        uint32_t y3 = (uint32_t)p0;
+        x0 = y0; x1 = y1; x2 = y2; x3 = y3;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = x0;
+    out[1] = x1;
+    out[2] = x2;
+    out[3] = x3;
+}
+
+//static
+void Philox::generate_batch(
+    const uint32_t *c0, const uint32_t *c1, const uint32_t *c2, const uint32_t *c3,
+    const uint32_t key[2], int n,
+    uint32_t *o0, uint32_t *o1, uint32_t *o2, uint32_t *o3)
+{
+    for (int i = 0; i < n; ++i) {
+        o0[i] = c0[i];
+        o1[i] = c1[i];
+        o2[i] = c2[i];
+        o3[i] = c3[i];
+    }
+
+    //rounds on the outside, lanes on the inside
+    //keeps every lane in the same round so the inner loop is a straight SIMD loop
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (int i = 0; i < n; ++i) {
+            uint64_t p0 = (uint64_t)PHILOX_M0 * o0[i];
+            uint64_t p1 = (uint64_t)PHILOX_M1 * o2[i];
+            uint32_t y0 = (uint32_t)(p1 >> 32) ^ o1[i] ^ k0;
+            uint32_t y2 = (uint32_t)(p0 >> 32) ^ o3[i] ^ k1;
+            o0[i] = y0;
+            o1[i] = (uint32_t)p1;
+            o2[i] = y2;
+            o3[i] = (uint32_t)p0;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+//static
+float Philox::to_float(uint32_t x) {
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+RandomStream::RandomStream(uint32_t seed, int px, int py, int sample, int bounce) {
+    key[0] = seed;
+    key[1] = 0;
+    counter[0] = (uint32_t)px;
+    counter[1] = (uint32_t)py;
+    counter[2] = (uint32_t)sample;
+    counter[3] = (uint32_t)bounce << 24;
+    used = 4;
+}
+
+void RandomStream::refill() {
+    Philox::generate(counter, key, block);
+    counter[3] = (counter[3] & ~BLOCK_MASK) | ((counter[3] + 1) & BLOCK_MASK);
+    used = 0;
+}
+
+float RandomStream::next_float() {
+    if (used == 4) {
+        refill();
+    }
+    return Philox::to_float(block[used++]);
+}
+
+void RandomStream::next_floats(float *out, int n) {
+    int i = 0;
+
+    //drain what's left of the current block first
+    while (i < n && used < 4) {
+        out[i++] = Philox::to_float(block[used++]);
+    }
+
+    //whole blocks go through the batch kernel
+    const int LANES = 16;
+    uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+    uint32_t o0[LANES], o1[LANES], o2[LANES], o3[LANES];
+    while (n - i >= 4) {
+        int blocks = (n - i) / 4;
+        if (blocks > LANES) blocks = LANES;
+        for (int b = 0; b < blocks; ++b) {
+            c0[b] = counter[0];
+            c1[b] = counter[1];
+            c2[b] = counter[2];
+            c3[b] = counter[3];
+            counter[3] = (counter[3] & ~BLOCK_MASK) | ((counter[3] + 1) & BLOCK_MASK);
+        }
+        Philox::generate_batch(c0, c1, c2, c3, key, blocks, o0, o1, o2, o3);
+        for (int b = 0; b < blocks; ++b) {
+            out[i++] = Philox::to_float(o0[b]);
+            out[i++] = Philox::to_float(o1[b]);
+            out[i++] = Philox::to_float(o2[b]);
+            out[i++] = Philox::to_float(o3[b]);
+        }
+    }
+
+    //tail
+    while (i < n) {
+        out[i++] = next_float();
+    }
+}
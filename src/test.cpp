@@ -616,3 +616,122 @@ TEST(PlaneIntersection, PlaneReturnsCorrectIntersection) {
     //std::cout  << dist1 << " " << dist1_pl << std::endl;
 }
 
+
+TEST(IntervalIntersection, MatchesFullIntersection) {
+    mat4 trsp = Transform::translate(0.5, 0.0, -6.0);
+    Sphere sp1 = Sphere(1.5, &trsp, vec4(1.0), 1.0);
+    Plane pl1 = Plane(vec3(0.0, 1.0, 0.0), 1.0, vec4(1.0), 1.0);
+    mat4 trlg = Transform::translate(-2.0, 3.0, -13.0);
+    Light lg1 = Light(1.0, &trlg, vec4(1.0), 1.0, LightType::point);
+    Object *objs[3] = {&sp1, &pl1, &lg1};
+
+    float TOLERANCE = 0.001;
+    for (int o = 0; o < 3; o++) {
+        for (int i = -10; i <= 10; i++) {
+            for (int j = -10; j <= 10; j++) {
+                Ray ray = Ray(vec3(0.0), vec3(i * 0.05, j * 0.05, -1.0), RayType::camera);
+                vec3 hit, n;
+                float dist1, dist2, t;
+                int prim;
+                bool full = objs[o]->intersects(ray, hit, n, dist1, dist2);
+                bool interval = objs[o]->intersects(ray, 0.0f, INFINITY, t, prim);
+                EXPECT_EQ(full, interval);
+                if (full && interval) {
+                    EXPECT_NEAR(t, dist1, TOLERANCE);
+                    EXPECT_EQ(prim, 0);
+                }
+            }
+        }
+    }
+}
+
+TEST(IntervalIntersection, HitsOutsideIntervalAreRejected) {
+    mat4 trsp = Transform::translate(0.0, 0.0, -5.0);
+    Sphere sp1 = Sphere(1.0, &trsp, vec4(1.0), 1.0);
+    Ray ray = Ray(vec3(0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+    float t = -1.0;
+    int prim;
+
+    EXPECT_TRUE(sp1.intersects(ray, 0.0f, INFINITY, t, prim));
+    EXPECT_NEAR(t, 4.0, 0.001);
+    //something nearer was already found
+    EXPECT_FALSE(sp1.intersects(ray, 0.0f, 4.0f, t, prim));
+    EXPECT_FALSE(sp1.intersects(ray, 0.0f, 2.5f, t, prim));
+    EXPECT_FALSE(sp1.intersects(ray, 4.5f, INFINITY, t, prim));
+    EXPECT_TRUE(sp1.intersects(ray, 0.0f, 4.01f, t, prim));
+}
+
+TEST(IntervalIntersection, TriangleDistanceIsAlongDirection) {
+    Triangle tr1 = Triangle(vec3(-1.0, -1.0, -10.0), vec3(1.0, -1.0, -10.0), vec3(0.0, 1.0, -10.0), vec4(1.0));
+    float t = -1.0;
+    int prim;
+    Ray camera = Ray(vec3(0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+    EXPECT_TRUE(tr1.intersects(camera, 0.0f, INFINITY, t, prim));
+    EXPECT_NEAR(t, 10.0, 0.001);
+
+    //a ray that doesn't start at the camera, with an unnormalized direction
+    Ray reflected = Ray(vec3(0.0, 0.0, -5.0), vec3(0.0, 0.0, -2.0), RayType::shadow);
+    EXPECT_TRUE(tr1.intersects(reflected, 0.0f, INFINITY, t, prim));
+    EXPECT_NEAR(t, 5.0, 0.001);
+    vec3 hit, n;
+    float dist1, dist2;
+    EXPECT_TRUE(tr1.intersects(reflected, hit, n, dist1, dist2));
+    EXPECT_NEAR(dist1, 5.0, 0.001);
+
+    HitRecord rec;
+    rec.t = t;
+    SurfaceInteraction si;
+    tr1.compute_surface_interaction(reflected, rec, si);
+    EXPECT_NEAR(si.position.z, -5.0 - 0.99 * 5.0, 0.001);
+
+    Ray away = Ray(vec3(0.0, 0.0, -5.0), vec3(0.0, 0.0, 1.0), RayType::shadow);
+    EXPECT_FALSE(tr1.intersects(away, 0.0f, INFINITY, t, prim));
+}
+
+TEST(SurfaceInteraction, MatchesFullIntersection) {
+    mat4 trsp = Transform::translate(0.5, 0.0, -6.0);
+    Sphere sp1 = Sphere(1.5, &trsp, vec4(1.0), 0.97);
+    Plane pl1 = Plane(vec3(0.0, 1.0, 0.0), 1.0, vec4(1.0), 0.99);
+    mat4 trlg = Transform::translate(-2.0, 3.0, -13.0);
+    Light lg1 = Light(1.0, &trlg, vec4(1.0), 0.97, LightType::point);
+    Object *objs[3] = {&sp1, &pl1, &lg1};
+
+    float TOLERANCE = 0.001;
+    for (int o = 0; o < 3; o++) {
+        for (int i = -10; i <= 10; i++) {
+            for (int j = -10; j <= 10; j++) {
+                Ray ray = Ray(vec3(0.0), vec3(i * 0.05, j * 0.05, -1.0), RayType::camera);
+                vec3 hit, n;
+                float dist1, dist2;
+                HitRecord rec;
+                if (!objs[o]->intersects(ray, 0.0f, INFINITY, rec.t, rec.prim)) continue;
+                ASSERT_TRUE(objs[o]->intersects(ray, hit, n, dist1, dist2));
+
+                SurfaceInteraction si;
+                objs[o]->compute_surface_interaction(ray, rec, si);
+                EXPECT_NEAR(si.position.x, hit.x, TOLERANCE);
+                EXPECT_NEAR(si.position.y, hit.y, TOLERANCE);
+                EXPECT_NEAR(si.position.z, hit.z, TOLERANCE);
+                EXPECT_NEAR(si.n.x, n.x, TOLERANCE);
+                EXPECT_NEAR(si.n.y, n.y, TOLERANCE);
+                EXPECT_NEAR(si.n.z, n.z, TOLERANCE);
+            }
+        }
+    }
+}
+
+TEST(SurfaceInteraction, TexturedSphereGetsUV) {
+    mat4 trsp = Transform::translate(0.0, 0.0, -5.0);
+    Sphere sp1 = Sphere(1.0, &trsp, vec4(1.0), 1.0, true, "resources/test.png");
+    Ray ray = Ray(vec3(0.0), vec3(0.05, 0.1, -1.0), RayType::camera);
+
+    HitRecord rec;
+    ASSERT_TRUE(sp1.intersects(ray, 0.0f, INFINITY, rec.t, rec.prim));
+    SurfaceInteraction si;
+    sp1.compute_surface_interaction(ray, rec, si);
+
+    float u, v;
+    sp1.get_uv(si.n, u, v);
+    EXPECT_EQ(si.u, u);
+    EXPECT_EQ(si.v, v);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <src/bvh.hpp>
+#include <src/animation.hpp>
+#include <src/rng.hpp>
+#include <vector>
+
+namespace {
+class BVHTest: public ::testing::Test
+{
+protected:
+    std::vector<Object*> spheres;
+    BVH bvh;
+
+    BVHTest() {
+        //a random cloud of spheres in front of the origin
+        RandomStream rs = RandomStream(9, 0, 0, 0, 0);
+        for (int i = 0; i < 200; i++) {
+            mat4 tr = Transform::translate(
+                rs.next_float() * 20.0 - 10.0,
+                rs.next_float() * 20.0 - 10.0,
+                -5.0 - rs.next_float() * 30.0);
+            spheres.push_back(new Sphere(0.2 + rs.next_float(), &tr, vec4(1.0), 1.0));
+        }
+        bvh.build(spheres);
+    }
+
+    virtual ~BVHTest() {
+        for (unsigned int i = 0; i < spheres.size(); i++) {
+            delete spheres[i];
+        }
+    }
+
+    Object* brute_force(const Ray &ray, float &nearest) {
+        Object *best = NULL;
+        vec3 hit, n;
+        float t0, t1;
+        for (unsigned int i = 0; i < spheres.size(); i++) {
+            if (spheres[i]->intersects(ray, hit, n, t0, t1) && t0 < nearest) {
+                nearest = t0;
+                best = spheres[i];
+            }
+        }
+        return best;
+    }
+
+    Object* traversal(const Ray &ray, float &nearest) {
+        Object *best = NULL;
+        vec3 hit, n;
+        float t0, t1;
+        bvh.traverse(ray, nearest, [&](Object *obj) {
+            if (obj->intersects(ray, hit, n, t0, t1) && t0 < nearest) {
+                nearest = t0;
+                best = obj;
+            }
+        });
+        return best;
+    }
+
+    void expect_same_hits() {
+        RandomStream rs = RandomStream(10, 0, 0, 0, 0);
+        for (int i = 0; i < 500; i++) {
+            vec3 dir = glm::normalize(vec3(rs.next_float() - 0.5, rs.next_float() - 0.5, -1.0));
+            Ray ray = Ray(vec3(0.0), dir, RayType::camera);
+            float near_bf = INFINITY, near_bvh = INFINITY;
+            EXPECT_EQ(brute_force(ray, near_bf), traversal(ray, near_bvh));
+            EXPECT_EQ(near_bf, near_bvh);
+        }
+    }
+};
+
+TEST_F(BVHTest, RootBoundsEveryObject) {
+    AABB root = bvh.nodes[0].box;
+    for (unsigned int i = 0; i < spheres.size(); i++) {
+        AABB b = spheres[i]->get_bounds();
+        EXPECT_LE(root.min.x, b.min.x);
+        EXPECT_LE(root.min.y, b.min.y);
+        EXPECT_LE(root.min.z, b.min.z);
+        EXPECT_GE(root.max.x, b.max.x);
+        EXPECT_GE(root.max.y, b.max.y);
+        EXPECT_GE(root.max.z, b.max.z);
+    }
+}
+
+TEST_F(BVHTest, TraversalFindsSameClosestHitAsBruteForce) {
+    expect_same_hits();
+}
+
+TEST_F(BVHTest, RefitTracksMovedObjects) {
+    Animation animation;
+    for (unsigned int i = 0; i < spheres.size(); i += 3) {
+        vec4 c = ((Sphere*)spheres[i])->center;
+        AnimationTrack &track = animation.track(spheres[i]);
+        track.add_key(Keyframe(0.0, vec3(c)));
+        track.add_key(Keyframe(1.0, vec3(c) + vec3(4.0, -2.0, 1.0)));
+    }
+    int nodes = bvh.nodes.size();
+
+    EXPECT_TRUE(animation.apply(0.5));
+    bvh.refit();
+    EXPECT_EQ((int)bvh.nodes.size(), nodes);
+    expect_same_hits();
+
+    EXPECT_TRUE(animation.apply(1.0));
+    bvh.refit();
+    expect_same_hits();
+
+    //nothing moves past the last key
+    EXPECT_FALSE(animation.apply(2.0));
+}
+
+TEST_F(BVHTest, UnboundedObjectsAreStillFound) {
+    Plane *ground = new Plane(vec3(0.0, 1.0, 0.0), 3.0, vec4(1.0), 1.0);
+    spheres.push_back(ground);
+    bvh.build(spheres);
+    EXPECT_TRUE(bvh.nodes[0].box.is_infinite());
+    expect_same_hits();
+}
+
+} //namespace
+
+TEST(Animation, InterpolatesBetweenKeys) {
+    mat4 tr = Transform::translate(0.0, 0.0, 0.0);
+    Sphere sp1 = Sphere(1.0, &tr, vec4(1.0), 1.0);
+
+    Animation animation;
+    AnimationTrack &track = animation.track(&sp1);
+    track.add_key(Keyframe(2.0, vec3(4.0, 0.0, -2.0), Keyframe::axis_angle(90.0, vec3(0.0, 1.0, 0.0))));
+    track.add_key(Keyframe(0.0, vec3(0.0, 0.0, 0.0)));
+    EXPECT_EQ(track.keys[0].time, 0.0);
+
+    float TOLERANCE = 0.001;
+    animation.apply(1.0);
+    EXPECT_NEAR(sp1.center.x, 2.0, TOLERANCE);
+    EXPECT_NEAR(sp1.center.y, 0.0, TOLERANCE);
+    EXPECT_NEAR(sp1.center.z, -1.0, TOLERANCE);
+
+    //halfway through the rotation x maps to (cos 45, 0, -sin 45)
+    vec4 x = sp1.objectToWorld * vec4(1.0, 0.0, 0.0, 0.0);
+    EXPECT_NEAR(x.x, 0.707, TOLERANCE);
+    EXPECT_NEAR(x.z, -0.707, TOLERANCE);
+
+    animation.apply(5.0);
+    EXPECT_NEAR(sp1.center.x, 4.0, TOLERANCE);
+    EXPECT_NEAR(sp1.center.z, -2.0, TOLERANCE);
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <src/denoise.hpp>
+#include <src/rng.hpp>
+#include <vector>
+
+namespace {
+float TOLERANCE = 0.0001;
+
+const int W = 64;
+const int H = 48;
+
+//a floor in the left half and a wall in the right half, both seen at the
+//same depth, with noise on top of their colours
+void split_scene(std::vector<vec3> &rgb, GuideBuffers &guides, float noise) {
+    guides.resize(W, H);
+    rgb.assign(W * H, vec3(0.0));
+    RandomStream rs = RandomStream(21, 0, 0, 0, 0);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int p = y * W + x;
+            bool left = x < W / 2;
+            guides.normal[p] = left ? vec3(0.0, 1.0, 0.0) : vec3(-1.0, 0.0, 0.0);
+            guides.albedo[p] = left ? vec3(0.2, 0.6, 0.2) : vec3(0.6, 0.2, 0.2);
+            guides.depth[p] = 10.0;
+            rgb[p] = guides.albedo[p] + vec3(noise * (rs.next_float() - 0.5));
+        }
+    }
+}
+
+double variance(const std::vector<vec3> &rgb, int x0, int x1) {
+    double sum = 0.0, sum2 = 0.0;
+    int n = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = x0; x < x1; x++) {
+            double g = rgb[y * W + x].g;
+            sum += g;
+            sum2 += g * g;
+            n++;
+        }
+    }
+    return sum2 / n - (sum / n) * (sum / n);
+}
+
+TEST(Denoiser, LeavesCleanImagesAlone) {
+    std::vector<vec3> rgb;
+    GuideBuffers guides;
+    split_scene(rgb, guides, 0.0);
+    std::vector<vec3> clean = rgb;
+    ThreadPool pool(2);
+    Denoiser().run(rgb, guides, pool);
+    for (int p = 0; p < W * H; p++) {
+        EXPECT_NEAR(rgb[p].r, clean[p].r, TOLERANCE);
+        EXPECT_NEAR(rgb[p].g, clean[p].g, TOLERANCE);
+    }
+}
+
+TEST(Denoiser, SmoothsNoiseButNotEdges) {
+    std::vector<vec3> rgb;
+    GuideBuffers guides;
+    split_scene(rgb, guides, 0.3);
+    double before = variance(rgb, 0, W / 2);
+    ThreadPool pool(2);
+    Denoiser().run(rgb, guides, pool);
+    EXPECT_LT(variance(rgb, 0, W / 2), 0.1 * before);
+    EXPECT_LT(variance(rgb, W / 2, W), 0.1 * before);
+
+    //columns right next to the edge keep their own side's colour
+    for (int y = 0; y < H; y++) {
+        EXPECT_NEAR(rgb[y * W + W / 2 - 1].g, 0.6, 0.05);
+        EXPECT_NEAR(rgb[y * W + W / 2].g, 0.2, 0.05);
+    }
+}
+
+TEST(Denoiser, MissesStayBlack) {
+    std::vector<vec3> rgb;
+    GuideBuffers guides;
+    split_scene(rgb, guides, 0.3);
+    //sky across the top rows
+    for (int p = 0; p < 8 * W; p++) {
+        guides.depth[p] = -1.0;
+        rgb[p] = vec3(0.0);
+    }
+    ThreadPool pool(2);
+    Denoiser().run(rgb, guides, pool);
+    for (int p = 0; p < 8 * W; p++) {
+        EXPECT_EQ(rgb[p], vec3(0.0));
+    }
+}
+
+TEST(Denoiser, ResultIsIndependentOfThreadCount) {
+    std::vector<vec3> a, b;
+    GuideBuffers guides;
+    split_scene(a, guides, 0.3);
+    b = a;
+    ThreadPool one(1), four(4);
+    Denoiser().run(a, guides, one);
+    Denoiser().run(b, guides, four);
+    for (int p = 0; p < W * H; p++) {
+        EXPECT_EQ(a[p], b[p]);
+    }
+}
+
+} //namespace
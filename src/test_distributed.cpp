@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <src/distributed.hpp>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+//a renderer whose output only depends on the pixel, like render_tile
+void gradient_renderer(const Tile &tile, vec3 *rgb) {
+    for (int j = tile.y0; j < tile.y1; j++) {
+        for (int i = tile.x0; i < tile.x1; i++) {
+            rgb[(j - tile.y0) * tile.width() + (i - tile.x0)] = vec3(i * 0.01, j * 0.01, (i ^ j) * 0.001);
+        }
+    }
+}
+
+class TileCoordinatorTest: public ::testing::Test
+{
+protected:
+    Camera* cam;
+    mat4* world_matrix;
+    std::vector<Tile> tiles;
+    std::vector<vec3> image;
+    int sink_calls;
+
+    TileCoordinatorTest() {
+        world_matrix = new mat4(1.0);
+        cam = new Camera(world_matrix, 70, 45, 45.0, 45.0, vec3(0.0));
+        tiles = make_tiles(cam, 16);
+        image.assign(70 * 45, vec3(-1.0));
+        sink_calls = 0;
+    }
+
+    virtual ~TileCoordinatorTest() {
+        delete cam;
+        delete world_matrix;
+    }
+
+    TileSink sink() {
+        return [this](const Tile &tile, const vec3 *rgb) {
+            sink_calls++;
+            for (int j = tile.y0; j < tile.y1; j++) {
+                for (int i = tile.x0; i < tile.x1; i++) {
+                    image[j * 70 + i] = rgb[(j - tile.y0) * tile.width() + (i - tile.x0)];
+                }
+            }
+        };
+    }
+
+    void expect_complete_image() {
+        EXPECT_EQ(sink_calls, (int)tiles.size());
+        std::vector<vec3> expected(70 * 45);
+        Tile full = {0, 0, 70, 45};
+        gradient_renderer(full, &expected[0]);
+        for (unsigned int p = 0; p < expected.size(); p++) {
+            EXPECT_EQ(image[p], expected[p]);
+        }
+    }
+};
+
+TEST_F(TileCoordinatorTest, TilesCoverTheImage) {
+    int pixels = 0;
+    for (unsigned int t = 0; t < tiles.size(); t++) {
+        pixels += tiles[t].size();
+    }
+    EXPECT_EQ(tiles.size(), 15u);
+    EXPECT_EQ(pixels, 70 * 45);
+}
+
+TEST_F(TileCoordinatorTest, WorkersAssembleTheSameImage) {
+    TileCoordinator coordinator = TileCoordinator(3, 30.0);
+    coordinator.render(tiles, gradient_renderer, sink());
+    expect_complete_image();
+    EXPECT_EQ(coordinator.failed_workers, 0);
+    EXPECT_EQ(coordinator.reissued, 0);
+}
+
+TEST_F(TileCoordinatorTest, TilesFromCrashedWorkerAreReissued) {
+    TileCoordinator coordinator = TileCoordinator(2, 30.0);
+    TileRenderer crashing = [](const Tile &tile, vec3 *rgb) {
+        if (TileCoordinator::worker_index == 0) {
+            _exit(1);
+        }
+        gradient_renderer(tile, rgb);
+    };
+    coordinator.render(tiles, crashing, sink());
+    expect_complete_image();
+    EXPECT_EQ(coordinator.failed_workers, 1);
+    EXPECT_GE(coordinator.reissued, 1);
+}
+
+TEST_F(TileCoordinatorTest, TilesFromSlowWorkerAreReissued) {
+    TileCoordinator coordinator = TileCoordinator(2, 0.2);
+    TileRenderer slow = [](const Tile &tile, vec3 *rgb) {
+        if (TileCoordinator::worker_index == 0) {
+            sleep(5);
+        }
+        gradient_renderer(tile, rgb);
+    };
+    coordinator.render(tiles, slow, sink());
+    expect_complete_image();
+    EXPECT_GE(coordinator.reissued, 1);
+}
+
+TEST_F(TileCoordinatorTest, HungWorkersAreKilled) {
+    TileCoordinator coordinator = TileCoordinator(2, 0.2);
+    TileRenderer hanging = [](const Tile &tile, vec3 *rgb) {
+        if (TileCoordinator::worker_index >= 0) {
+            sleep(1000);
+        }
+        gradient_renderer(tile, rgb);
+    };
+    coordinator.render(tiles, hanging, sink());
+    expect_complete_image();
+    EXPECT_EQ(coordinator.failed_workers, 2);
+}
+
+TEST_F(TileCoordinatorTest, CoordinatorFinishesWhenAllWorkersFail) {
+    TileCoordinator coordinator = TileCoordinator(2, 30.0);
+    TileRenderer crashing = [](const Tile &tile, vec3 *rgb) {
+        if (TileCoordinator::worker_index >= 0) {
+            _exit(1);
+        }
+        gradient_renderer(tile, rgb);
+    };
+    coordinator.render(tiles, crashing, sink());
+    expect_complete_image();
+    EXPECT_EQ(coordinator.failed_workers, 2);
+}
+
+} //namespace
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <src/framebuffer.hpp>
+#include <src/thread_pool.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+//pixel value that encodes its own position
+vec3 expected_color(int i, int j) {
+    return vec3((i % 256) / 255.0, (j % 256) / 255.0, ((i + j) % 256) / 255.0);
+}
+
+class StreamingImageTest: public ::testing::Test
+{
+protected:
+    Camera* cam;
+    mat4* world_matrix;
+    std::string path;
+
+    StreamingImageTest() {
+        world_matrix = new mat4(1.0);
+        cam = new Camera(world_matrix, 203, 150, 45.0, 45.0, vec3(0.0));
+        path = "stream_test.ppm";
+    }
+
+    virtual ~StreamingImageTest() {
+        delete cam;
+        delete world_matrix;
+        remove(path.c_str());
+    }
+
+    void fill(const Tile &tile, std::vector<vec3> &rgb) {
+        rgb.resize(tile.size());
+        for (int j = tile.y0; j < tile.y1; j++) {
+            for (int i = tile.x0; i < tile.x1; i++) {
+                rgb[(j - tile.y0) * tile.width() + (i - tile.x0)] = expected_color(i, j);
+            }
+        }
+    }
+
+    void expect_file_matches() {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::string magic;
+        int w, h, maxval;
+        in >> magic >> w >> h >> maxval;
+        in.get();
+        EXPECT_EQ(magic, "P6");
+        EXPECT_EQ(w, 203);
+        EXPECT_EQ(h, 150);
+        EXPECT_EQ(maxval, 255);
+
+        std::vector<unsigned char> px(w * h * 3);
+        in.read((char*)&px[0], px.size());
+        EXPECT_EQ(in.gcount(), (std::streamsize)px.size());
+        int mismatches = 0;
+        for (int j = 0; j < h; j++) {
+            for (int i = 0; i < w; i++) {
+                vec3 c = expected_color(i, j);
+                const unsigned char *p = &px[(j * w + i) * 3];
+                if (p[0] != (unsigned char)(c.r * 255.0) ||
+                    p[1] != (unsigned char)(c.g * 255.0) ||
+                    p[2] != (unsigned char)(c.b * 255.0)) {
+                    mismatches++;
+                }
+            }
+        }
+        EXPECT_EQ(mismatches, 0);
+    }
+};
+
+TEST_F(StreamingImageTest, OutOfOrderTilesLandInPlace) {
+    std::vector<Tile> tiles = make_tiles(cam, 32);
+    StreamingImage image(path, 203, 150, 32, 100, false);
+    ASSERT_TRUE(image.is_open());
+
+    std::vector<vec3> rgb;
+    for (int t = tiles.size() - 1; t >= 0; t--) {
+        fill(tiles[t], rgb);
+        image.write_tile(tiles[t], &rgb[0]);
+    }
+    EXPECT_TRUE(image.close());
+    expect_file_matches();
+}
+
+TEST_F(StreamingImageTest, ThreadedWritesStayWithinBandWindow) {
+    std::vector<Tile> tiles = make_tiles(cam, 16);
+    StreamingImage image(path, 203, 150, 16, 2, true);
+    ASSERT_TRUE(image.is_open());
+
+    ThreadPool pool(4);
+    pool.parallel_for(tiles.size(), [&](int t) {
+        std::vector<vec3> rgb;
+        fill(tiles[t], rgb);
+        image.write_tile(tiles[t], &rgb[0]);
+    });
+    EXPECT_TRUE(image.close());
+    EXPECT_LE(image.peak_bands, 2u);
+    expect_file_matches();
+}
+
+TEST_F(StreamingImageTest, MissingTilesAreReported) {
+    std::vector<Tile> tiles = make_tiles(cam, 32);
+    StreamingImage image(path, 203, 150, 32, 100, false);
+    std::vector<vec3> rgb;
+    for (unsigned int t = 1; t < tiles.size(); t++) {
+        fill(tiles[t], rgb);
+        image.write_tile(tiles[t], &rgb[0]);
+    }
+    EXPECT_FALSE(image.close());
+}
+
+} //namespace
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <src/frustum.hpp>
+#include <src/bvh.hpp>
+#include <src/rng.hpp>
+#include <src/main.h>
+#include <algorithm>
+#include <vector>
+
+namespace {
+//a packet looking down -z through [x0, x1] x [y0, y1] on the z = -1 plane
+Frustum make_frustum(float x0, float y0, float x1, float y1) {
+    vec3 corners[4] = {
+        vec3(x0, y0, -1.0), vec3(x1, y0, -1.0), vec3(x1, y1, -1.0), vec3(x0, y1, -1.0)};
+    return Frustum(vec3(0.0), corners);
+}
+
+TEST(Frustum, rejectsBoxesOutsideTheSides) {
+    Frustum f = make_frustum(-0.1, -0.1, 0.1, 0.1);
+    EXPECT_TRUE(f.overlaps(AABB(vec3(-0.5, -0.5, -11.0), vec3(0.5, 0.5, -10.0))));
+    EXPECT_FALSE(f.overlaps(AABB(vec3(5.0, -0.5, -11.0), vec3(6.0, 0.5, -10.0))));
+    EXPECT_FALSE(f.overlaps(AABB(vec3(-0.5, 3.0, -11.0), vec3(0.5, 4.0, -10.0))));
+    //behind the origin
+    EXPECT_FALSE(f.overlaps(AABB(vec3(-0.5, -0.5, 10.0), vec3(0.5, 0.5, 11.0))));
+    //straddling a side plane
+    EXPECT_TRUE(f.overlaps(AABB(vec3(0.9, -0.5, -10.0), vec3(1.5, 0.5, -9.0))));
+    EXPECT_TRUE(f.overlaps(AABB::infinite()));
+    EXPECT_FALSE(f.overlaps(AABB()));
+}
+
+TEST(Frustum, windingDoesNotMatter) {
+    vec3 corners[4] = {
+        vec3(-0.1, -0.1, -1.0), vec3(-0.1, 0.1, -1.0), vec3(0.1, 0.1, -1.0), vec3(0.1, -0.1, -1.0)};
+    Frustum f = Frustum(vec3(0.0), corners);
+    EXPECT_TRUE(f.overlaps(AABB(vec3(-0.5, -0.5, -11.0), vec3(0.5, 0.5, -10.0))));
+    EXPECT_FALSE(f.overlaps(AABB(vec3(5.0, -0.5, -11.0), vec3(6.0, 0.5, -10.0))));
+}
+
+TEST(Frustum, cullKeepsEveryObjectAPacketRayCanHit) {
+    std::vector<Object*> spheres;
+    RandomStream rs = RandomStream(17, 0, 0, 0, 0);
+    for (int i = 0; i < 300; i++) {
+        mat4 tr = Transform::translate(
+            rs.next_float() * 40.0 - 20.0,
+            rs.next_float() * 40.0 - 20.0,
+            -5.0 - rs.next_float() * 30.0);
+        spheres.push_back(new Sphere(0.2 + rs.next_float(), &tr, vec4(1.0), 1.0));
+    }
+    BVH bvh;
+    bvh.build(spheres);
+
+    Frustum f = make_frustum(-0.2, -0.1, 0.1, 0.2);
+    std::vector<Object*> candidates;
+    EXPECT_TRUE(bvh.cull(f, candidates, spheres.size()));
+    EXPECT_LT(candidates.size(), spheres.size() / 2);
+
+    for (int i = 0; i <= 20; i++) {
+        for (int j = 0; j <= 20; j++) {
+            Ray ray = Ray(vec3(0.0), vec3(-0.2 + i * 0.015, -0.1 + j * 0.015, -1.0), RayType::camera);
+            for (unsigned int s = 0; s < spheres.size(); s++) {
+                float t;
+                int prim;
+                if (spheres[s]->intersects(ray, 0.0f, INFINITY, t, prim)) {
+                    EXPECT_NE(std::find(candidates.begin(), candidates.end(), spheres[s]), candidates.end());
+                }
+            }
+        }
+    }
+
+    //too many survivors gives up
+    EXPECT_FALSE(bvh.cull(make_frustum(-10.0, -10.0, 10.0, 10.0), candidates, 4));
+
+    for (unsigned int i = 0; i < spheres.size(); i++) {
+        delete spheres[i];
+    }
+}
+
+TEST(Frustum, packetTileMatchesPerRayTile) {
+    Camera *camera = world_setup();
+    std::vector<Tile> tiles = make_tiles(camera, TILE_SIZE);
+
+    RenderOptions packets, per_ray;
+    per_ray.packets = false;
+    for (unsigned int t = 0; t < tiles.size(); t += 7) {
+        std::vector<vec3> a(tiles[t].size()), b(tiles[t].size());
+        render_tile(camera, tiles[t], &a[0], packets);
+        render_tile(camera, tiles[t], &b[0], per_ray);
+        for (int p = 0; p < tiles[t].size(); p++) {
+            EXPECT_EQ(a[p], b[p]);
+        }
+    }
+    world_teardown(camera);
+}
+
+} //namespace
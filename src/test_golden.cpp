@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <src/image_diff.hpp>
+#include <src/framebuffer.hpp>
+#include <src/instance.hpp>
+#include <src/main.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern std::vector<Object*> objects;
+extern std::vector<Geometry*> geometries;
+
+//Golden image suite
+//Each canonical scene is rendered on this thread and compared with its
+//reference in resources/golden. A failed comparison leaves the render next to
+//the usual output in test/ for a look. Run with RT_UPDATE_GOLDEN=1 set to
+//write the current renders as the new references after an intended change.
+//Time and ray rate budgets apply too. RT_TIME_BUDGETS scales them for a
+//loaded or instrumented machine: RT_TIME_BUDGETS=2 allows twice the time and
+//half the rate of the budgets below, RT_TIME_BUDGETS=0 turns them off.
+//The scenes have no textures, so the references don't depend on the image
+//decoder FreeImage was built with.
+
+namespace {
+
+const std::string GOLDEN_DIR = "resources/golden/";
+const std::string CANDIDATE_DIR = "test/";
+const int GOLDEN_WIDTH = 160;
+const int GOLDEN_HEIGHT = 120;
+
+TEST(ImageDiff, IdenticalImagesHaveInfinitePSNR) {
+    PPMImage a;
+    a.width = 2;
+    a.height = 1;
+    a.rgb.assign(6, 100);
+    ImageDiff diff = ImageDiff::compare(a, a);
+    EXPECT_TRUE(std::isinf(diff.psnr));
+    EXPECT_EQ(diff.max_error, 0);
+    EXPECT_EQ(diff.differing, 0);
+}
+
+TEST(ImageDiff, ReportsWorstChannelAndPSNR) {
+    PPMImage a, b;
+    a.width = b.width = 2;
+    a.height = b.height = 1;
+    a.rgb.assign(6, 100);
+    b.rgb = a.rgb;
+    b.rgb[4] = 110;
+    ImageDiff diff = ImageDiff::compare(a, b);
+    EXPECT_EQ(diff.max_error, 10);
+    EXPECT_EQ(diff.differing, 1);
+    //mse is 100 / 6
+    EXPECT_NEAR(diff.psnr, 10.0 * log10(255.0 * 255.0 * 6.0 / 100.0), 0.0001);
+
+    b.width = 1;
+    diff = ImageDiff::compare(a, b);
+    EXPECT_EQ(diff.psnr, 0.0);
+    EXPECT_EQ(diff.max_error, 255);
+}
+
+TEST(ImageDiff, ReadsWhatStreamingImageWrites) {
+    std::string path = CANDIDATE_DIR + "image_diff_roundtrip.ppm";
+    Tile tile;
+    tile.x0 = tile.y0 = 0;
+    tile.x1 = 3;
+    tile.y1 = 2;
+    std::vector<vec3> rgb(tile.size(), vec3(1.0, 0.5, 0.0));
+    {
+        StreamingImage image(path, 3, 2, 2, 1);
+        image.write_tile(tile, &rgb[0]);
+        ASSERT_TRUE(image.close());
+    }
+
+    PPMImage read;
+    ASSERT_TRUE(read.read(path));
+    EXPECT_EQ(read.width, 3);
+    EXPECT_EQ(read.height, 2);
+    ASSERT_EQ(read.rgb.size(), 18u);
+    EXPECT_EQ(read.rgb[0], 255);
+    EXPECT_EQ(read.rgb[1], 127);
+    EXPECT_EQ(read.rgb[2], 0);
+    remove(path.c_str());
+
+    EXPECT_FALSE(read.read(GOLDEN_DIR + "missing.ppm"));
+}
+
+//what a scene may cost before it counts as a regression
+//times are for the Makefile's unoptimized build, with room for a loaded machine
+struct Budget
+{
+    double min_psnr; //dB
+    int max_error; //worst single channel, 0-255
+    double max_seconds;
+    double min_rays_per_second;
+};
+
+const Budget DEFAULT_BUDGET = {40.0, 8, 1.0, 200000.0};
+//instance rays pay for a transform and a second BVH walk
+const Budget INSTANCES_BUDGET = {40.0, 8, 2.0, 50000.0};
+
+//0 when time isn't checked
+double budget_scale() {
+    const char *value = getenv("RT_TIME_BUDGETS");
+    if (value == NULL || *value == '\0') return 1.0;
+    char *end;
+    double scale = strtod(value, &end);
+    if (end == value || scale < 0.0) return 1.0;
+    return scale;
+}
+
+void spheres_setup() {
+    mat4 tr = Transform::translate(-2.0, 3.0, -13.0);
+    objects.push_back(new Light(1.0, &tr, vec4(1.0, 1.0, 1.0, 0.5), 0.97, LightType::point));
+    tr = Transform::translate(0.0, -0.75, -15.0);
+    objects.push_back(new Sphere(2.0, &tr, vec4(0.0, 0.0, 0.5, 1.0), 0.97));
+    tr = Transform::translate(-3.0, -0.25, -11.0);
+    objects.push_back(new Sphere(0.75, &tr, vec4(0.0, 0.5, 0.7, 1.0), 0.97));
+    objects.push_back(new Triangle(vec3(2.0, -1.0, -14.0), vec3(5.0, -1.0, -16.0), vec3(3.5, 2.5, -15.0), vec4(1.0, 0.0, 0.0, 1.0)));
+    objects.push_back(new Plane(vec3(0.0, 1.0, 0.0), 1.0, vec4(0.0, 0.5, 0.0, 1.0), 0.99));
+}
+
+//a grid of small trees sharing one Geometry, the two level BVH path
+void instances_setup() {
+    mat4 tr = Transform::translate(-2.0, 3.0, -13.0);
+    objects.push_back(new Light(1.0, &tr, vec4(1.0, 1.0, 1.0, 0.5), 0.97, LightType::point));
+    objects.push_back(new Plane(vec3(0.0, 1.0, 0.0), 1.0, vec4(0.0, 0.5, 0.0, 1.0), 0.99));
+
+    Geometry *tree = new Geometry();
+    tr = Transform::translate(0.0, 0.0, 0.0);
+    tree->add(new Sphere(0.15, &tr, vec4(0.4, 0.25, 0.1, 1.0), 0.97));
+    tr = Transform::translate(0.0, 0.6, 0.0);
+    tree->add(new Sphere(0.45, &tr, vec4(0.1, 0.5, 0.1, 1.0), 0.97));
+    tree->build();
+    geometries.push_back(tree);
+
+    for (int i = 0; i < 400; i++) {
+        mat4 otw = Transform::translate((i % 20) * 0.8 - 7.6, -1.0, -6.0 - (i / 20) * 1.0);
+        objects.push_back(new Instance(tree, &otw, vec4(0.1, 0.5, 0.1, 1.0)));
+    }
+}
+
+struct GoldenScene
+{
+    std::string name;
+    std::string reference; //renders that must agree share a reference
+    std::function<void ()> setup;
+    RenderOptions options;
+    Budget budget;
+};
+
+void check_scene(const GoldenScene &scene) {
+    mat4 view = mat4(1.0);
+    Camera *camera = new Camera(&view, GOLDEN_WIDTH, GOLDEN_HEIGHT, 45.0, 45.0, vec3(0.0));
+    scene.setup();
+    compile_scene();
+
+    std::string candidate = CANDIDATE_DIR + "golden_" + scene.name + ".ppm";
+    std::vector<Tile> tiles = make_tiles(camera, TILE_SIZE);
+    StreamingImage image(candidate, GOLDEN_WIDTH, GOLDEN_HEIGHT, TILE_SIZE, 1, false);
+    std::vector<vec3> rgb(TILE_SIZE * TILE_SIZE);
+
+    long rays = rays_cast();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < tiles.size(); t++) {
+        render_tile(camera, tiles[t], &rgb[0], scene.options);
+        image.write_tile(tiles[t], &rgb[0]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    rays = rays_cast() - rays;
+    ASSERT_TRUE(image.close());
+    world_teardown(camera);
+
+    std::string reference = GOLDEN_DIR + scene.reference + ".ppm";
+    if (getenv("RT_UPDATE_GOLDEN") != NULL) {
+        ASSERT_EQ(rename(candidate.c_str(), reference.c_str()), 0) << "can't write " << reference;
+        std::cout << "updated " << reference << std::endl;
+        return;
+    }
+
+    PPMImage expected, actual;
+    ASSERT_TRUE(expected.read(reference)) << reference << " is missing, run with RT_UPDATE_GOLDEN=1 to create it";
+    ASSERT_TRUE(actual.read(candidate));
+    ImageDiff diff = ImageDiff::compare(expected, actual);
+    EXPECT_GE(diff.psnr, scene.budget.min_psnr) << scene.name << " differs from " << reference << ", see " << candidate;
+    EXPECT_LE(diff.max_error, scene.budget.max_error) << scene.name << ": " << diff.differing << " pixels off, see " << candidate;
+    if (diff.psnr >= scene.budget.min_psnr && diff.max_error <= scene.budget.max_error) {
+        remove(candidate.c_str());
+    }
+
+    double scale = budget_scale();
+    if (scale == 0.0) return;
+    double rate = rays / seconds;
+    EXPECT_LE(seconds, scene.budget.max_seconds * scale) << scene.name << " took " << seconds << "s";
+    EXPECT_GE(rate, scene.budget.min_rays_per_second / scale) << scene.name << " cast " << rays << " rays in " << seconds << "s";
+}
+
+TEST(GoldenImage, Spheres) {
+    GoldenScene scene = {"spheres", "spheres", spheres_setup, RenderOptions(), DEFAULT_BUDGET};
+    check_scene(scene);
+}
+
+TEST(GoldenImage, SortedRaysWithoutPacketsMatchSpheres) {
+    GoldenScene scene = {"spheres_sorted", "spheres", spheres_setup, RenderOptions(), DEFAULT_BUDGET};
+    scene.options.sort_rays = true;
+    scene.options.packets = false;
+    check_scene(scene);
+}
+
+TEST(GoldenImage, Shadows) {
+    GoldenScene scene = {"shadows", "shadows", spheres_setup, RenderOptions(), DEFAULT_BUDGET};
+    scene.options.shadow_rays = true;
+    scene.options.occluder_cache = true;
+    scene.options.reflections = 3;
+    check_scene(scene);
+}
+
+TEST(GoldenImage, Instances) {
+    GoldenScene scene = {"instances", "instances", instances_setup, RenderOptions(), INSTANCES_BUDGET};
+    scene.options.shadow_rays = true;
+    check_scene(scene);
+}
+
+} //namespace
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <src/instance.hpp>
+#include <vector>
+
+namespace {
+class InstanceTest: public ::testing::Test
+{
+protected:
+    Geometry *unit_sphere;
+    float TOLERANCE = 0.001;
+
+    InstanceTest() {
+        unit_sphere = new Geometry();
+        mat4 id = mat4(1.0);
+        unit_sphere->add(new Sphere(1.0, &id, vec4(1.0), 1.0));
+        unit_sphere->build();
+    }
+
+    virtual ~InstanceTest() {
+        delete unit_sphere;
+    }
+};
+
+TEST_F(InstanceTest, TranslatedInstanceMatchesWorldSphere) {
+    mat4 tr = Transform::translate(3.0, 3.0, -3.0);
+    Instance inst = Instance(unit_sphere, &tr, vec4(1.0));
+    Sphere sp1 = Sphere(1.0, &tr, vec4(1.0), 1.0);
+
+    Ray ray = Ray(vec3(0.0), vec3(1.0, 1.0, -1.0), RayType::camera);
+    vec3 hit, n, ref_hit, ref_n;
+    float dist1, dist2, ref_dist1, ref_dist2;
+    EXPECT_TRUE(inst.intersects(ray, hit, n, dist1, dist2));
+    EXPECT_TRUE(sp1.intersects(ray, ref_hit, ref_n, ref_dist1, ref_dist2));
+
+    EXPECT_NEAR(dist1, ref_dist1, TOLERANCE);
+    EXPECT_NEAR(dist2, ref_dist2, TOLERANCE);
+    EXPECT_NEAR(hit.x, ref_hit.x, TOLERANCE);
+    EXPECT_NEAR(hit.y, ref_hit.y, TOLERANCE);
+    EXPECT_NEAR(hit.z, ref_hit.z, TOLERANCE);
+    EXPECT_NEAR(n.x, ref_n.x, TOLERANCE);
+    EXPECT_NEAR(n.y, ref_n.y, TOLERANCE);
+    EXPECT_NEAR(n.z, ref_n.z, TOLERANCE);
+}
+
+TEST_F(InstanceTest, ScaledInstanceReportsWorldDistances) {
+    mat4 otw = Transform::translate(0.0, 0.0, -10.0) * Transform::scale(2.0, 2.0, 2.0);
+    Instance inst = Instance(unit_sphere, &otw, vec4(1.0));
+
+    Ray ray = Ray(vec3(0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+    vec3 hit, n;
+    float dist1, dist2;
+    EXPECT_TRUE(inst.intersects(ray, hit, n, dist1, dist2));
+    EXPECT_NEAR(dist1, 8.0, TOLERANCE);
+    EXPECT_NEAR(dist2, 12.0, TOLERANCE);
+    EXPECT_NEAR(hit.z, -8.0, TOLERANCE);
+    EXPECT_NEAR(n.z, 1.0, TOLERANCE);
+
+    AABB box = inst.get_bounds();
+    EXPECT_NEAR(box.min.z, -12.0, TOLERANCE);
+    EXPECT_NEAR(box.max.x, 2.0, TOLERANCE);
+
+    Ray miss = Ray(vec3(0.0), vec3(0.0, 1.0, -3.0), RayType::camera);
+    EXPECT_FALSE(inst.intersects(miss, hit, n, dist1, dist2));
+}
+
+TEST_F(InstanceTest, NonUniformScaleKeepsNormalsPerpendicular) {
+    //an ellipsoid squashed along y, hit on the slope
+    mat4 otw = Transform::translate(0.0, 0.0, -5.0) * Transform::scale(1.0, 0.5, 1.0);
+    Instance inst = Instance(unit_sphere, &otw, vec4(1.0));
+
+    Ray ray = Ray(vec3(0.0, 0.3, 0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+    vec3 hit, n;
+    float dist1, dist2;
+    EXPECT_TRUE(inst.intersects(ray, hit, n, dist1, dist2));
+
+    //implicit surface x^2 + (2y)^2 + (z+5)^2 = 1 has gradient (x, 4y, z+5)
+    vec3 expected = glm::normalize(vec3(hit.x, 4.0 * hit.y, hit.z + 5.0));
+    EXPECT_NEAR(n.x, expected.x, TOLERANCE);
+    EXPECT_NEAR(n.y, expected.y, TOLERANCE);
+    EXPECT_NEAR(n.z, expected.z, TOLERANCE);
+}
+
+TEST_F(InstanceTest, TwoLevelHierarchyFindsNearestInstance) {
+    std::vector<Object*> instances;
+    for (int i = 0; i < 1000; i++) {
+        mat4 otw = Transform::translate((i % 10) * 3.0, ((i / 10) % 10) * 3.0, -10.0 - (i / 100) * 3.0);
+        instances.push_back(new Instance(unit_sphere, &otw, vec4(1.0)));
+    }
+    BVH top;
+    top.build(instances);
+
+    //every instance shares the single primitive
+    EXPECT_EQ(unit_sphere->prims.size(), 1u);
+
+    Ray ray = Ray(vec3(9.0, 6.0, 0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+    vec3 hit, n;
+    float dist1, dist2;
+    float nearest = INFINITY;
+    Object *best = NULL;
+    top.traverse(ray, nearest, [&](Object *obj) {
+        if (obj->intersects(ray, hit, n, dist1, dist2) && dist1 < nearest) {
+            nearest = dist1;
+            best = obj;
+        }
+    });
+    EXPECT_EQ(best, instances[23]);
+    EXPECT_NEAR(nearest, 9.0, TOLERANCE);
+
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        delete instances[i];
+    }
+}
+
+TEST_F(InstanceTest, IntervalQueryReportsWorldDistanceAndPrimitive) {
+    Geometry pair;
+    mat4 tr = Transform::translate(0.0, 0.0, 2.0);
+    pair.add(new Sphere(0.5, &tr, vec4(1.0), 1.0));
+    tr = Transform::translate(0.0, 0.0, -2.0);
+    pair.add(new Sphere(0.5, &tr, vec4(1.0), 1.0));
+    pair.build();
+
+    mat4 otw = Transform::translate(0.0, 0.0, -10.0) * Transform::scale(2.0, 2.0, 2.0);
+    Instance inst = Instance(&pair, &otw, vec4(1.0));
+    Ray ray = Ray(vec3(0.0), vec3(0.0, 0.0, -1.0), RayType::camera);
+
+    float t;
+    int prim;
+    EXPECT_TRUE(inst.intersects(ray, 0.0f, INFINITY, t, prim));
+    EXPECT_NEAR(t, 5.0, TOLERANCE);
+    //the nearer sphere is the one placed at +z in object space
+    EXPECT_EQ(pair.bvh.prims[prim], pair.prims[0]);
+
+    //with the near sphere cut off the far one wins
+    EXPECT_TRUE(inst.intersects(ray, 6.0f, INFINITY, t, prim));
+    EXPECT_NEAR(t, 13.0, TOLERANCE);
+    EXPECT_EQ(pair.bvh.prims[prim], pair.prims[1]);
+
+    EXPECT_FALSE(inst.intersects(ray, 0.0f, 5.0f, t, prim));
+}
+
+TEST_F(InstanceTest, SurfaceInteractionMatchesFullIntersection) {
+    mat4 otw = Transform::translate(1.0, 0.5, -8.0) *
+        mat4(Transform::rotate(30.0, vec3(0.0, 1.0, 0.0))) *
+        Transform::scale(1.0, 0.5, 2.0);
+    Instance inst = Instance(unit_sphere, &otw, vec4(1.0));
+    Ray ray = Ray(vec3(0.0), vec3(0.1, 0.05, -1.0), RayType::camera);
+
+    vec3 hit, n;
+    float dist1, dist2;
+    HitRecord rec;
+    ASSERT_TRUE(inst.intersects(ray, hit, n, dist1, dist2));
+    ASSERT_TRUE(inst.intersects(ray, 0.0f, INFINITY, rec.t, rec.prim));
+    rec.object = &inst;
+
+    SurfaceInteraction si;
+    inst.compute_surface_interaction(ray, rec, si);
+    EXPECT_NEAR(si.position.x, hit.x, TOLERANCE);
+    EXPECT_NEAR(si.position.y, hit.y, TOLERANCE);
+    EXPECT_NEAR(si.position.z, hit.z, TOLERANCE);
+    EXPECT_NEAR(si.n.x, n.x, TOLERANCE);
+    EXPECT_NEAR(si.n.y, n.y, TOLERANCE);
+    EXPECT_NEAR(si.n.z, n.z, TOLERANCE);
+}
+
+} //namespace
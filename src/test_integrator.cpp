@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <src/main.h>
+#include <vector>
+
+//scene globals from main.cpp
+extern std::vector<Object*> objects;
+
+namespace {
+
+//every tile of the image, rendered one after the other
+std::vector<vec3> render_image(Camera *camera, const RenderOptions &options) {
+    std::vector<Tile> tiles = make_tiles(camera, TILE_SIZE);
+    std::vector<vec3> image;
+    for (unsigned int t = 0; t < tiles.size(); t++) {
+        std::vector<vec3> rgb(tiles[t].size());
+        render_tile(camera, tiles[t], &rgb[0], options);
+        image.insert(image.end(), rgb.begin(), rgb.end());
+    }
+    return image;
+}
+
+TEST(Integrator, SpecializedKernelsMatchTheGeneric) {
+    RenderOptions options;
+    options.width = 128;
+    options.height = 96;
+    Camera *camera = world_setup(options);
+
+    RenderOptions variants[5] = {options, options, options, options, options};
+    variants[1].shadow_rays = true;
+    variants[2].shadow_rays = true;
+    variants[2].occluder_cache = true;
+    variants[3].reflections = 3;
+    variants[4].sort_rays = true;
+    variants[4].shadow_rays = true;
+    for (int v = 0; v < 5; v++) {
+        RenderOptions generic = variants[v];
+        generic.specialize = false;
+        std::vector<vec3> expected = render_image(camera, generic);
+        std::vector<vec3> actual = render_image(camera, variants[v]);
+        ASSERT_EQ(expected.size(), actual.size());
+        for (unsigned int p = 0; p < expected.size(); p++) {
+            ASSERT_EQ(expected[p], actual[p]) << integrator_name(variants[v]) << " pixel " << p;
+        }
+    }
+    world_teardown(camera);
+}
+
+TEST(Integrator, PicksKernelForSceneAndOptions) {
+    //the default scene has a textured sphere
+    Camera *camera = world_setup();
+    RenderOptions options;
+    EXPECT_EQ(integrator_name(options), "textures on, shadows none, depth 1");
+    options.shadow_rays = true;
+    options.occluder_cache = true;
+    options.reflections = 4;
+    EXPECT_EQ(integrator_name(options), "textures on, shadows cached, depth any");
+    options.specialize = false;
+    options.reflections = 0;
+    EXPECT_EQ(integrator_name(options), "textures on, shadows cached, depth any");
+    world_teardown(camera);
+
+    //without the texture the scene gets the plain kernels
+    camera = world_setup();
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        objects[i]->has_texture = false;
+    }
+    compile_scene();
+    options = RenderOptions();
+    EXPECT_EQ(integrator_name(options), "textures off, shadows none, depth 1");
+    options.shadow_rays = true;
+    EXPECT_EQ(integrator_name(options), "textures off, shadows traced, depth 1");
+    options.specialize = false;
+    EXPECT_EQ(integrator_name(options), "textures on, shadows traced, depth any");
+    world_teardown(camera);
+}
+
+} //namespace
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <src/irradiance_cache.hpp>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace {
+float TOLERANCE = 0.0001;
+
+IrradianceRecord flat_record(const vec3 &p, const vec3 &n, const vec3 &irradiance, float radius) {
+    IrradianceRecord rec;
+    rec.position = p;
+    rec.n = n;
+    rec.irradiance = irradiance;
+    rec.radius = radius;
+    for (int c = 0; c < 3; c++) {
+        rec.grad_t[c] = vec3(0.0);
+        rec.grad_r[c] = vec3(0.0);
+    }
+    return rec;
+}
+
+//ceiling at y = 1 above the origin, lit only where x > 0
+float half_lit_ceiling(const vec3 &origin, const vec3 &dir, vec3 &radiance) {
+    float t = (1.0 - origin.y) / dir.y;
+    float x = origin.x + t * dir.x;
+    radiance = x > 0.0 ? vec3(1.0) : vec3(0.0);
+    return t;
+}
+
+TEST(IrradianceCache, ConstantSkyIntegratesToPiTimesRadiance) {
+    IrradianceCache cache;
+    RandomStream rs = RandomStream(1, 0, 0, 0, 0);
+    vec3 sky = vec3(1.0, 0.5, 0.25);
+    IrradianceRecord rec = cache.sample(vec3(0.0), vec3(0.0, 1.0, 0.0), 6, 18, rs,
+        [&](const vec3&, const vec3&, vec3 &radiance) {
+            radiance = sky;
+            return (float)INFINITY;
+        });
+
+    for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(rec.irradiance[c], M_PI * sky[c], TOLERANCE);
+        //nothing nearby, so moving the point changes nothing
+        EXPECT_NEAR(glm::length(rec.grad_t[c]), 0.0, TOLERANCE);
+    }
+    EXPECT_EQ(rec.radius, cache.max_radius);
+}
+
+TEST(IrradianceCache, LookupHonoursDistanceAndNormal) {
+    IrradianceCache cache(0.4, 0.2, 4.0);
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    vec3 irradiance;
+    EXPECT_FALSE(cache.lookup(vec3(0.0), up, irradiance));
+
+    cache.insert(flat_record(vec3(0.0), up, vec3(0.5, 0.25, 1.0), 1.0));
+    EXPECT_EQ(cache.size(), 1);
+    ASSERT_TRUE(cache.lookup(vec3(0.1, 0.0, 0.0), up, irradiance));
+    EXPECT_NEAR(irradiance.r, 0.5, TOLERANCE);
+    EXPECT_NEAR(irradiance.b, 1.0, TOLERANCE);
+
+    //past error * radius, or facing another way
+    EXPECT_FALSE(cache.lookup(vec3(0.5, 0.0, 0.0), up, irradiance));
+    EXPECT_FALSE(cache.lookup(vec3(0.1, 0.0, 0.0), vec3(1.0, 0.0, 0.0), irradiance));
+
+    //records in other cells are found through the copies insert made
+    cache.insert(flat_record(vec3(1.59, 0.0, 0.0), up, vec3(0.0), 1.0));
+    EXPECT_TRUE(cache.lookup(vec3(1.61, 0.0, 0.0), up, irradiance));
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_FALSE(cache.lookup(vec3(0.0), up, irradiance));
+}
+
+TEST(IrradianceCache, GradientsExtrapolateFromTheRecord) {
+    IrradianceCache cache;
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    IrradianceRecord rec = flat_record(vec3(0.0), up, vec3(1.0), 2.0);
+    rec.grad_t[0] = vec3(1.0, 0.0, 0.0);
+    rec.grad_r[1] = vec3(0.0, 0.0, 1.0);
+    cache.insert(rec);
+
+    vec3 irradiance;
+    ASSERT_TRUE(cache.lookup(vec3(0.2, 0.0, 0.0), up, irradiance));
+    EXPECT_NEAR(irradiance.r, 1.2, TOLERANCE);
+    EXPECT_NEAR(irradiance.g, 1.0, TOLERANCE);
+
+    //tilting the normal towards +x turns n_i x n towards -z
+    vec3 tilted = glm::normalize(vec3(0.05, 1.0, 0.0));
+    ASSERT_TRUE(cache.lookup(vec3(0.0), tilted, irradiance));
+    EXPECT_NEAR(irradiance.g, 1.0 + glm::cross(up, tilted).z, TOLERANCE);
+    EXPECT_LT(irradiance.g, 1.0);
+}
+
+TEST(IrradianceCache, SampledGradientPredictsNeighbours) {
+    IrradianceCache cache;
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    RandomStream rs0 = RandomStream(2, 0, 0, 0, 0);
+    IrradianceRecord rec = cache.sample(vec3(0.0), up, 16, 48, rs0, half_lit_ceiling);
+    //half the hemisphere sees the light
+    EXPECT_NEAR(rec.irradiance.r, M_PI * 0.5, 0.05);
+    EXPECT_GT(rec.grad_t[0].x, 0.0);
+    cache.insert(rec);
+
+    RandomStream rs1 = RandomStream(2, 1, 0, 0, 0);
+    vec3 p = vec3(0.15, 0.0, 0.0);
+    IrradianceRecord actual = cache.sample(p, up, 16, 48, rs1, half_lit_ceiling);
+    vec3 predicted;
+    ASSERT_TRUE(cache.lookup(p, up, predicted));
+    EXPECT_LT(fabs(predicted.r - actual.irradiance.r), 0.5 * fabs(rec.irradiance.r - actual.irradiance.r));
+}
+
+TEST(IrradianceCache, ConcurrentInsertsAreAllKept) {
+    IrradianceCache cache;
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    const int THREADS = 4;
+    const int PER_THREAD = 250;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.push_back(std::thread([&cache, &up, t] {
+            RandomStream rs = RandomStream(3, t, 0, 0, 0);
+            for (int i = 0; i < PER_THREAD; i++) {
+                vec3 p = vec3(rs.next_float(), rs.next_float(), rs.next_float()) * 20.0f - 10.0f;
+                vec3 irradiance;
+                if (!cache.lookup(p, up, irradiance)) {
+                    cache.insert(flat_record(p, up, vec3(1.0), 0.2 + rs.next_float()));
+                }
+                else {
+                    cache.insert(flat_record(p, up, irradiance, 0.2));
+                }
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    EXPECT_EQ(cache.size(), THREADS * PER_THREAD);
+
+    vec3 irradiance;
+    RandomStream rs = RandomStream(3, 0, 0, 0, 0);
+    vec3 p = vec3(rs.next_float(), rs.next_float(), rs.next_float()) * 20.0f - 10.0f;
+    ASSERT_TRUE(cache.lookup(p, up, irradiance));
+    EXPECT_NEAR(irradiance.g, 1.0, TOLERANCE);
+}
+
+} //namespace
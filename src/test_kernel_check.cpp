@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <src/kernel_check.hpp>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace {
+
+const uint32_t SEED = 0xd1ff;
+const long CASES = 20000;
+
+TEST(KernelCheck, UlpDistance) {
+    EXPECT_EQ(KernelCheck::ulp_distance(1.0f, 1.0f), 0u);
+    EXPECT_EQ(KernelCheck::ulp_distance(1.0f, nextafterf(1.0f, 2.0f)), 1u);
+    EXPECT_EQ(KernelCheck::ulp_distance(nextafterf(1.0f, 0.0f), 1.0f), 1u);
+    EXPECT_EQ(KernelCheck::ulp_distance(0.0f, -0.0f), 0u);
+    //across zero through the denormals
+    float tiny = nextafterf(0.0f, 1.0f);
+    EXPECT_EQ(KernelCheck::ulp_distance(-tiny, tiny), 2u);
+    EXPECT_EQ(KernelCheck::ulp_distance(NAN, 1.0f), UINT32_MAX);
+    EXPECT_EQ(KernelCheck::ulp_distance(NAN, NAN), 0u);
+}
+
+TEST(KernelCheck, BuiltinKernelsMatchTheReferences) {
+    KernelCheck check = KernelCheck(SEED);
+    check.add_builtin();
+    std::vector<KernelCheck::Report> reports = check.run(CASES);
+    ASSERT_EQ(reports.size(), 3u);
+    for (unsigned int k = 0; k < reports.size(); k++) {
+        std::ostringstream out;
+        KernelCheck::write_report(out, reports);
+        EXPECT_EQ(reports[k].cases, CASES);
+        EXPECT_EQ(reports[k].mismatches, 0) << out.str();
+    }
+}
+
+TEST(KernelCheck, CatchesAndShrinksABrokenKernel) {
+    //forgets that an origin inside the sphere is a hit at t = 0
+    KernelCheck check = KernelCheck(SEED);
+    check.add(KernelCheck::SPHERE, "outside_only", [](Object *obj, const Ray &ray, float tmin, float tmax, float &t) {
+        Sphere *sphere = (Sphere*)obj;
+        vec3 oc = vec3(sphere->center) - ray.origin;
+        if (glm::dot(oc, oc) < sphere->radius * sphere->radius) return false;
+        int prim;
+        return obj->intersects(ray, tmin, tmax, t, prim);
+    });
+    std::vector<KernelCheck::Report> reports = check.run(CASES);
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_GT(reports[0].mismatches, 0);
+    ASSERT_FALSE(reports[0].reproducers.empty());
+
+    //the shrunk case still shows the bug on its own
+    const KernelCheck::Mismatch &m = reports[0].reproducers[0];
+    EXPECT_TRUE(check.reference(m.input).hit);
+    EXPECT_EQ(check.reference(m.input).t0, 0.0f);
+    EXPECT_FALSE(check.evaluate("outside_only", m.input).hit);
+    EXPECT_EQ(m.ulps, UINT32_MAX);
+
+    std::ostringstream out;
+    KernelCheck::write_report(out, reports);
+    EXPECT_NE(out.str().find("outside_only reproducer 1, hit/miss disagree"), std::string::npos);
+}
+
+TEST(KernelCheck, ComparesQuadraticRoots) {
+    KernelCheck check = KernelCheck(SEED, 4);
+    check.add_quadratic("same", [](float a, float b, float c, float &r1, float &r2) {
+        return Transform::solve_quadratic(a, b, c, r1, r2);
+    });
+    //textbook formula, cancels when b dwarfs a and c
+    check.add_quadratic("textbook", [](float a, float b, float c, float &r1, float &r2) {
+        float d = b * b - 4 * a * c;
+        if (d < 0) return false;
+        r1 = (-b - sqrt(d)) / (2 * a);
+        r2 = (-b + sqrt(d)) / (2 * a);
+        if (r1 > r2) std::swap(r1, r2);
+        return true;
+    });
+    std::vector<KernelCheck::Report> reports = check.run(CASES);
+    ASSERT_EQ(reports.size(), 2u);
+    EXPECT_EQ(reports[0].mismatches, 0);
+    EXPECT_EQ(reports[0].max_ulps, 0u);
+    EXPECT_GT(reports[1].mismatches, 0);
+    EXPECT_GT(reports[1].max_ulps, 4u);
+}
+
+TEST(KernelCheck, RunsAreReproducible) {
+    KernelCheck a = KernelCheck(SEED, 0), b = KernelCheck(SEED, 0);
+    a.add_builtin();
+    b.add_builtin();
+    std::ostringstream out_a, out_b;
+    KernelCheck::write_report(out_a, a.run(2000));
+    KernelCheck::write_report(out_b, b.run(2000));
+    EXPECT_EQ(out_a.str(), out_b.str());
+}
+
+} //namespace
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <src/memory_tags.hpp>
+#include <sstream>
+#include <string>
+
+namespace {
+
+//the counters are global, so every check is against a baseline taken first
+
+struct Base : public Tagged<MemoryTag::tracker>
+{
+    virtual ~Base() {}
+};
+
+struct Derived : public Base
+{
+    char payload[256];
+};
+
+TEST(MemoryTags, VectorChargesItsTag) {
+    long before = MemoryAccount::current(MemoryTag::bvh);
+    long other = MemoryAccount::current(MemoryTag::rays);
+    {
+        TaggedVector<int, MemoryTag::bvh> v;
+        v.reserve(1000);
+        EXPECT_EQ(MemoryAccount::current(MemoryTag::bvh) - before, (long)(v.capacity() * sizeof(int)));
+
+        v.push_back(1);
+        TaggedVector<int, MemoryTag::bvh> copy = v;
+        EXPECT_GE(MemoryAccount::current(MemoryTag::bvh) - before, (long)(1001 * sizeof(int)));
+    }
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::bvh), before);
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::rays), other);
+}
+
+TEST(MemoryTags, PeakOutlivesTheAllocation) {
+    MemoryAccount::reset_peaks();
+    long before = MemoryAccount::current(MemoryTag::framebuffer);
+    EXPECT_EQ(MemoryAccount::peak(MemoryTag::framebuffer), before);
+    {
+        TaggedVector<char, MemoryTag::framebuffer> v(1 << 16);
+    }
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::framebuffer), before);
+    EXPECT_GE(MemoryAccount::peak(MemoryTag::framebuffer) - before, 1 << 16);
+
+    MemoryAccount::reset_peaks();
+    EXPECT_EQ(MemoryAccount::peak(MemoryTag::framebuffer), before);
+}
+
+TEST(MemoryTags, DeleteThroughBaseReleasesDerivedSize) {
+    long before = MemoryAccount::current(MemoryTag::tracker);
+    Base *b = new Derived();
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::tracker) - before, (long)sizeof(Derived));
+    delete b;
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::tracker), before);
+}
+
+TEST(MemoryTags, ManualChargesShowInReport) {
+    long before = MemoryAccount::current(MemoryTag::textures);
+    MemoryAccount::allocated(MemoryTag::textures, 4096);
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::textures) - before, 4096);
+
+    std::ostringstream out;
+    MemoryAccount::write_report(out);
+    std::string report = out.str();
+    for (int t = 0; t < (int)MemoryTag::COUNT; t++) {
+        EXPECT_NE(report.find(MemoryAccount::name((MemoryTag)t)), std::string::npos);
+    }
+
+    MemoryAccount::released(MemoryTag::textures, 4096);
+    EXPECT_EQ(MemoryAccount::current(MemoryTag::textures), before);
+}
+
+} //namespace
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <src/occluder_cache.hpp>
+#include <src/main.h>
+#include <vector>
+
+//scene globals from main.cpp
+extern std::vector<Object*> objects;
+extern std::vector<Light*> scene_lights;
+
+namespace {
+//shadow test against every object, no BVH and no cache
+bool brute_force_occluded(const vec3 &point, Light *light) {
+    vec3 to_light = vec3(light->center) - point;
+    float distance = glm::length(to_light);
+    Ray ray = Ray(point, to_light / distance, RayType::shadow, 0);
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        float t;
+        int prim;
+        if (objects[i]->type != ObjType::light &&
+            objects[i]->intersects(ray, 0.001f, distance - light->radius, t, prim)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(OccluderCache, StartsEmptyAndRemembers) {
+    mat4 id = mat4(1.0);
+    Sphere sp1 = Sphere(1.0, &id, vec4(1.0), 1.0);
+    OccluderCache cache = OccluderCache(2);
+    EXPECT_EQ(cache.get(0), (Object*)NULL);
+    EXPECT_EQ(cache.get(1), (Object*)NULL);
+    cache.set(1, &sp1);
+    EXPECT_EQ(cache.get(0), (Object*)NULL);
+    EXPECT_EQ(cache.get(1), &sp1);
+    cache.clear();
+    EXPECT_EQ(cache.get(1), (Object*)NULL);
+}
+
+TEST(OccluderCache, CachedAndUncachedShadowsAgree) {
+    Camera *camera = world_setup();
+    ASSERT_EQ(scene_lights.size(), 1u);
+    OccluderCache cache = OccluderCache(scene_lights.size());
+
+    //points on the ground plane around the sphere
+    int blocked = 0, total = 0;
+    for (int i = 0; i < 40; i++) {
+        for (int k = 0; k < 40; k++) {
+            vec3 point = vec3(-6.0 + i * 0.3, -1.0 + 0.001, -21.0 + k * 0.3);
+            bool expected = brute_force_occluded(point, scene_lights[0]);
+            EXPECT_EQ(occluded(point, 0, NULL), expected);
+            EXPECT_EQ(occluded(point, 0, &cache), expected);
+            if (expected) blocked++;
+            total++;
+        }
+    }
+    //the sphere casts a shadow, but not everywhere
+    EXPECT_GT(blocked, 0);
+    EXPECT_LT(blocked, total);
+
+    //neighbouring shadowed points share the sphere as occluder
+    EXPECT_GT(cache.lookups, 0);
+    EXPECT_GT(cache.hits, blocked / 2);
+    world_teardown(camera);
+}
+
+} //namespace
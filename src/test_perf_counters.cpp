@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <src/perf_counters.hpp>
+
+namespace {
+
+TEST(PerfCounters, CountOrSayWhyNot) {
+    PerfCounters counters;
+    PerfCounters::Reading before, after;
+    counters.read(before);
+    volatile double x = 0.0;
+    for (int i = 0; i < 1000000; i++) {
+        x += i;
+    }
+    counters.read(after);
+
+    if (!counters.available()) {
+        //no PMU here, every event reads zero
+        EXPECT_FALSE(counters.error().empty());
+        for (int e = 0; e < PerfCounters::EVENTS; e++) {
+            EXPECT_FALSE(counters.has(e));
+            EXPECT_EQ(after.values[e], 0u);
+        }
+        return;
+    }
+    EXPECT_TRUE(counters.error().empty());
+    for (int e = 0; e < PerfCounters::EVENTS; e++) {
+        EXPECT_GE(after.values[e], before.values[e]);
+    }
+    uint64_t counted[PerfCounters::EVENTS];
+    PerfCounters::difference(before, after, counted);
+    if (counters.has(PerfCounters::INSTRUCTIONS)) {
+        EXPECT_GT(counted[PerfCounters::INSTRUCTIONS], 1000000u);
+    }
+}
+
+TEST(PerfCounters, DifferenceScalesByTheIntervalsShare) {
+    PerfCounters::Reading start, end;
+    //half counted so far, all of the next interval counted
+    start.values[0] = 1000;
+    start.enabled = 100;
+    start.running = 50;
+    end.values[0] = 1010;
+    end.enabled = 200;
+    end.running = 150;
+    uint64_t counted[PerfCounters::EVENTS];
+    PerfCounters::difference(start, end, counted);
+    //scaling each total first would give 1346 - 2000 here
+    EXPECT_EQ(counted[0], 10u);
+
+    //a quarter of the interval counted
+    end.values[0] = 1010;
+    end.running = 75;
+    PerfCounters::difference(start, end, counted);
+    EXPECT_EQ(counted[0], 40u);
+
+    //never below zero
+    end.values[0] = 900;
+    PerfCounters::difference(start, end, counted);
+    EXPECT_EQ(counted[0], 0u);
+    EXPECT_EQ(counted[1], 0u);
+}
+
+} //namespace
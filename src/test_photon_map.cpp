@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <src/photon_map.hpp>
+#include <src/main.h>
+#include <src/rng.hpp>
+#include <algorithm>
+#include <vector>
+
+//scene globals from main.cpp
+extern PhotonMap photon_map;
+
+namespace {
+float TOLERANCE = 0.0001;
+
+std::vector<Photon> random_photons(int n, uint32_t seed) {
+    RandomStream rs = RandomStream(seed, 0, 0, 0, 0);
+    std::vector<Photon> photons;
+    for (int i = 0; i < n; i++) {
+        vec3 p = vec3(rs.next_float(), rs.next_float(), rs.next_float()) * 10.0f;
+        photons.push_back(Photon::pack(p, vec3(1.0), vec3(0.0, -1.0, 0.0)));
+    }
+    return photons;
+}
+
+TEST(PhotonMap, PhotonsPackIntoTwentyBytes) {
+    EXPECT_EQ(sizeof(Photon), 20u);
+
+    vec3 power = vec3(0.25, 0.0625, 3.0);
+    vec3 dir = glm::normalize(vec3(0.3, -0.8, 0.5));
+    Photon photon = Photon::pack(vec3(1.0, 2.0, 3.0), power, dir);
+    EXPECT_NEAR(photon.get_position().y, 2.0, TOLERANCE);
+    for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(photon.get_power()[c], power[c], 0.02);
+    }
+    EXPECT_GT(glm::dot(photon.get_direction(), dir), 0.999);
+}
+
+TEST(PhotonMap, NearestMatchesBruteForce) {
+    //odd sizes exercise the partially filled last level
+    int sizes[3] = {1, 100, 1537};
+    for (int s = 0; s < 3; s++) {
+        std::vector<Photon> photons = random_photons(sizes[s], s);
+        std::vector<Photon> input = photons;
+        ThreadPool pool(3);
+        PhotonMap map(1 << 20);
+        map.build(input, pool);
+        ASSERT_EQ(map.size(), photons.size());
+
+        RandomStream rs = RandomStream(50, s, 0, 0, 0);
+        for (int q = 0; q < 20; q++) {
+            vec3 p = vec3(rs.next_float(), rs.next_float(), rs.next_float()) * 10.0f;
+            std::vector<float> expected;
+            for (unsigned int i = 0; i < photons.size(); i++) {
+                vec3 d = photons[i].get_position() - p;
+                if (glm::dot(d, d) < 4.0) expected.push_back(glm::dot(d, d));
+            }
+            std::sort(expected.begin(), expected.end());
+            if (expected.size() > 8) expected.resize(8);
+
+            std::vector<int> found;
+            map.nearest(p, 8, 2.0, found);
+            ASSERT_EQ(found.size(), expected.size());
+            for (unsigned int i = 0; i < found.size(); i++) {
+                vec3 d = map.nodes()[found[i]].get_position() - p;
+                EXPECT_NEAR(glm::dot(d, d), expected[i], TOLERANCE);
+            }
+        }
+    }
+}
+
+TEST(PhotonMap, BuildIsIndependentOfThreadCount) {
+    std::vector<Photon> a = random_photons(5000, 7);
+    std::vector<Photon> b = a;
+    ThreadPool one(1), four(4);
+    PhotonMap serial(1 << 20), parallel(1 << 20);
+    serial.build(a, one);
+    parallel.build(b, four);
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (unsigned int i = 0; i < serial.size(); i++) {
+        EXPECT_EQ(serial.nodes()[i].get_position(), parallel.nodes()[i].get_position());
+    }
+}
+
+TEST(PhotonMap, DensityEstimateOfUniformPhotons) {
+    //one photon of power 0.01 per 0.1 x 0.1 square is an irradiance of 1
+    std::vector<Photon> photons;
+    for (int i = 0; i < 100; i++) {
+        for (int k = 0; k < 100; k++) {
+            vec3 p = vec3(i * 0.1, 0.0, k * 0.1);
+            photons.push_back(Photon::pack(p, vec3(0.01), vec3(0.0, -1.0, 0.0)));
+        }
+    }
+    ThreadPool pool(2);
+    PhotonMap map(1 << 20);
+    map.build(photons, pool);
+
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    vec3 e = map.irradiance(vec3(5.0, 0.0, 5.0), up, 100, 1.0);
+    EXPECT_NEAR(e.g, 1.0, 0.15);
+    //photons arriving from below don't light the top
+    vec3 back = map.irradiance(vec3(5.0, 0.0, 5.0), -up, 100, 1.0);
+    EXPECT_NEAR(back.g, 0.0, TOLERANCE);
+
+    std::vector<PhotonQuery> queries;
+    RandomStream rs = RandomStream(8, 0, 0, 0, 0);
+    for (int q = 0; q < 64; q++) {
+        PhotonQuery query = {vec3(rs.next_float() * 10.0, 0.0, rs.next_float() * 10.0), up};
+        queries.push_back(query);
+    }
+    std::vector<vec3> batch;
+    map.irradiance_batch(queries, 50, 1.0, batch);
+    ASSERT_EQ(batch.size(), queries.size());
+    for (unsigned int q = 0; q < queries.size(); q++) {
+        EXPECT_EQ(batch[q], map.irradiance(queries[q].position, up, 50, 1.0));
+    }
+}
+
+TEST(PhotonMap, BudgetCapsStoredPhotons) {
+    std::vector<Photon> photons = random_photons(1000, 9);
+    ThreadPool pool(1);
+    //building holds two copies
+    PhotonMap map(100 * 2 * sizeof(Photon));
+    EXPECT_EQ(map.capacity(), 100u);
+    map.build(photons, pool);
+    EXPECT_EQ(map.size(), 100u);
+    EXPECT_EQ(map.bytes(), 100 * sizeof(Photon));
+    map.clear();
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(PhotonMap, SceneEmissionIsReproducible) {
+    Camera *camera = world_setup();
+    ThreadPool one(1), three(3);
+    emit_photons(20000, one);
+    std::vector<Photon> first = photon_map.nodes();
+    emit_photons(20000, three);
+    //photons heading down land on the plane or the spheres
+    EXPECT_GT(first.size(), 5000u);
+    ASSERT_EQ(photon_map.size(), first.size());
+    for (unsigned int i = 0; i < first.size(); i++) {
+        EXPECT_EQ(photon_map.nodes()[i].get_position(), first[i].get_position());
+    }
+    photon_map.clear();
+    world_teardown(camera);
+}
+
+//total flux of the stored photons
+vec3 stored_power() {
+    vec3 total = vec3(0.0);
+    for (unsigned int i = 0; i < photon_map.size(); i++) {
+        total += photon_map.nodes()[i].get_power();
+    }
+    return total;
+}
+
+TEST(PhotonMap, TightBudgetKeepsTheFlux) {
+    Camera *camera = world_setup();
+    ThreadPool pool(2);
+    emit_photons(20000, pool);
+    size_t all = photon_map.size();
+    vec3 expected = stored_power();
+
+    //room for about a tenth of them
+    PhotonMap saved = photon_map;
+    photon_map = PhotonMap(all / 10 * 2 * sizeof(Photon));
+    emit_photons(20000, pool);
+    EXPECT_LT(photon_map.size(), all / 5);
+    vec3 actual = stored_power();
+    for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(actual[c], expected[c], expected[c] * 0.15);
+    }
+
+    photon_map = saved;
+    photon_map.clear();
+    world_teardown(camera);
+}
+
+} //namespace
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include <src/profiler.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+//the json line of the first node with this name
+std::string node_line(const std::string &json, const std::string &name) {
+    size_t start = json.find("{\"name\": \"" + name + "\"");
+    if (start == std::string::npos) return "";
+    return json.substr(start, json.find('\n', start) - start);
+}
+
+std::string report(Profiler &profiler) {
+    std::ostringstream out;
+    profiler.write_json(out);
+    return out.str();
+}
+
+TEST(Profiler, NestedTimersCountCalls) {
+    Profiler profiler;
+    {
+        ScopedTimer outer(profiler, "outer");
+        for (int i = 0; i < 3; i++) {
+            ScopedTimer inner(profiler, "inner");
+        }
+    }
+    {
+        ScopedTimer outer(profiler, "outer");
+    }
+    EXPECT_TRUE(profiler.path().empty());
+
+    std::string json = report(profiler);
+    EXPECT_NE(node_line(json, "outer").find("\"calls\": 2,"), std::string::npos);
+    EXPECT_NE(node_line(json, "inner").find("\"calls\": 3,"), std::string::npos);
+    //inner sits inside outer's children
+    EXPECT_LT(json.find("\"outer\""), json.find("\"inner\""));
+
+    profiler.reset();
+    EXPECT_EQ(report(profiler).find("outer"), std::string::npos);
+}
+
+TEST(Profiler, ThreadCanSwitchBetweenProfilers) {
+    Profiler a, b;
+    {
+        ScopedTimer outer(a, "outer");
+        {
+            ScopedTimer other(b, "other");
+        }
+        ScopedTimer inner(a, "inner");
+        EXPECT_EQ(a.path().size(), 2u);
+    }
+    EXPECT_TRUE(a.path().empty());
+
+    std::string json = report(a);
+    EXPECT_NE(node_line(json, "outer").find("\"calls\": 1,"), std::string::npos);
+    EXPECT_NE(node_line(json, "inner").find("\"calls\": 1,"), std::string::npos);
+    EXPECT_EQ(json.find("other"), std::string::npos);
+    EXPECT_NE(node_line(report(b), "other").find("\"calls\": 1,"), std::string::npos);
+}
+
+TEST(Profiler, RetiredProfilersDontLoseLiveTimers) {
+    Profiler profiler;
+    ScopedTimer *outer = new ScopedTimer(profiler, "outer");
+    //each of these retires an id and empties the thread's cache
+    for (int i = 0; i < 100; i++) {
+        Profiler other;
+        ScopedTimer timer(other, "other");
+        other.reset();
+    }
+    EXPECT_EQ(profiler.path().size(), 1u);
+    delete outer;
+    EXPECT_NE(node_line(report(profiler), "outer").find("\"calls\": 1,"), std::string::npos);
+}
+
+TEST(Profiler, WorkOnOtherThreadsNestsUnderItsPhase) {
+    Profiler profiler;
+    {
+        ScopedTimer phase(profiler, "phase");
+        Profiler::Path path = profiler.path();
+        ASSERT_EQ(path.size(), 1u);
+
+        std::thread worker([&]() {
+            for (int i = 0; i < 2; i++) {
+                ScopedTimer task(profiler, "task", path);
+                profiler.add_rays(10);
+            }
+            EXPECT_TRUE(profiler.path().empty());
+        });
+        worker.join();
+        //the handing thread joins in without repeating the phase
+        ScopedTimer task(profiler, "task", path);
+        profiler.add_rays(5);
+    }
+
+    std::string json = report(profiler);
+    std::string task = node_line(json, "task");
+    EXPECT_NE(task.find("\"calls\": 3,"), std::string::npos);
+    EXPECT_NE(task.find("\"threads\": 2,"), std::string::npos);
+    EXPECT_NE(task.find("\"rays\": 25,"), std::string::npos);
+    //only one phase node, and its rays include the tasks'
+    EXPECT_EQ(json.find("\"phase\"", json.find("\"phase\"") + 1), std::string::npos);
+    EXPECT_NE(node_line(json, "phase").find("\"rays\": 25,"), std::string::npos);
+}
+
+TEST(Profiler, TextReportListsEveryPhase) {
+    Profiler profiler;
+    {
+        ScopedTimer setup(profiler, "setup");
+    }
+    {
+        ScopedTimer trace(profiler, "trace");
+        ScopedTimer tile(profiler, "tile");
+        profiler.add_rays(1000);
+    }
+    std::ostringstream out;
+    profiler.write_text(out);
+    std::string text = out.str();
+    EXPECT_NE(text.find("Mrays/s"), std::string::npos);
+    EXPECT_NE(text.find("\n  setup"), std::string::npos);
+    EXPECT_NE(text.find("\n    tile"), std::string::npos);
+}
+
+TEST(Profiler, CountersAreReportedOrExplained) {
+    Profiler profiler;
+    profiler.use_counters(true);
+    profiler.reset();
+    {
+        ScopedTimer trace(profiler, "trace");
+        profiler.add_rays(100);
+    }
+    std::ostringstream out;
+    profiler.write_text(out);
+    std::string json = report(profiler);
+    if (profiler.counters_error().empty()) {
+        EXPECT_NE(out.str().find("per ray"), std::string::npos);
+        EXPECT_NE(node_line(json, "trace").find("\"cycles\": "), std::string::npos);
+    }
+    else {
+        EXPECT_NE(out.str().find("hardware counters unavailable"), std::string::npos);
+        EXPECT_EQ(json.find("\"counters\""), std::string::npos);
+    }
+}
+
+TEST(Profiler, TimelineHasAnEventPerSpan) {
+    Profiler profiler;
+    profiler.use_timeline(true);
+    profiler.reset();
+    {
+        ScopedTimer render(profiler, "render");
+        Profiler::Path path = profiler.path();
+        std::thread worker([&]() {
+            ScopedTimer tile(profiler, "tile", path);
+            profiler.annotate(7);
+        });
+        worker.join();
+        ScopedTimer tile(profiler, "tile", path);
+        profiler.annotate(3);
+    }
+
+    std::ostringstream out;
+    profiler.write_timeline(out);
+    std::string trace = out.str();
+    EXPECT_EQ(trace.find("{\"displayTimeUnit\""), 0u);
+    int spans = 0;
+    for (size_t at = trace.find("\"ph\": \"X\""); at != std::string::npos; at = trace.find("\"ph\": \"X\"", at + 1)) {
+        spans++;
+    }
+    //the worker's borrowed render isn't a span of its own
+    EXPECT_EQ(spans, 3);
+    EXPECT_NE(trace.find("\"thread_name\""), std::string::npos);
+    EXPECT_NE(trace.find("\"id\": 7"), std::string::npos);
+    EXPECT_NE(trace.find("\"id\": 3"), std::string::npos);
+    EXPECT_NE(trace.find("\"tid\": 1"), std::string::npos);
+
+    //off by default
+    Profiler quiet;
+    {
+        ScopedTimer render(quiet, "render");
+    }
+    std::ostringstream none;
+    quiet.write_timeline(none);
+    EXPECT_EQ(none.str().find("\"ph\": \"X\""), std::string::npos);
+}
+
+} //namespace
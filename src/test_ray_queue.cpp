@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <src/ray_queue.hpp>
+#include <src/main.h>
+#include <algorithm>
+#include <vector>
+
+TEST(RayQueue, radixSortMatchesStableSort) {
+    const int N = 5000;
+    std::vector<uint32_t> keys(N);
+    std::vector<int> values(N);
+    std::vector<std::pair<uint32_t, int> > expected(N);
+    uint32_t x = 12345;
+    for (int i = 0; i < N; i++) {
+        x = x * 1664525u + 1013904223u;
+        //few distinct keys so stability matters
+        keys[i] = (x >> 8) & 0x070000ff;
+        values[i] = i;
+        expected[i] = std::make_pair(keys[i], i);
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+        [](const std::pair<uint32_t, int> &a, const std::pair<uint32_t, int> &b) { return a.first < b.first; });
+
+    RayQueue::radix_sort(keys, values);
+    for (int i = 0; i < N; i++) {
+        EXPECT_EQ(keys[i], expected[i].first);
+        EXPECT_EQ(values[i], expected[i].second);
+    }
+}
+
+TEST(RayQueue, keyOrdersByOctantThenCell) {
+    AABB bounds = AABB(vec3(0.0), vec3(10.0));
+    uint32_t a = RayQueue::coherence_key(vec3(9.0), vec3(1.0, 1.0, 1.0), bounds);
+    uint32_t b = RayQueue::coherence_key(vec3(0.0), vec3(-1.0, 1.0, 1.0), bounds);
+    uint32_t c = RayQueue::coherence_key(vec3(1.0), vec3(1.0, 1.0, 1.0), bounds);
+    EXPECT_LT(a, b);
+    EXPECT_LT(c, a);
+    EXPECT_EQ(b >> (3 * RayQueue::CELL_BITS), 1u);
+
+    //origins outside the bounds clamp to the edge cells
+    EXPECT_EQ(RayQueue::coherence_key(vec3(-5.0), vec3(1.0), bounds), 0u);
+    EXPECT_EQ(RayQueue::coherence_key(vec3(50.0), vec3(1.0), bounds),
+              RayQueue::coherence_key(vec3(10.0), vec3(1.0), bounds));
+}
+
+TEST(RayQueue, sortGroupsRaysByDirection) {
+    RayQueue queue;
+    for (int i = 0; i < 64; i++) {
+        float sx = (i & 1) ? -1.0 : 1.0;
+        float sy = (i & 2) ? -1.0 : 1.0;
+        QueuedRay ray = {vec3(i * 0.1, 0.0, 0.0), vec3(sx, sy, -1.0), RayType::shadow, NULL, i};
+        queue.push(ray);
+    }
+    queue.sort();
+    ASSERT_EQ(queue.size(), 64u);
+
+    //each octant shows up as one run
+    int runs = 1;
+    for (unsigned int i = 1; i < queue.size(); i++) {
+        bool same = (queue.rays[i].direction.x < 0) == (queue.rays[i - 1].direction.x < 0) &&
+                    (queue.rays[i].direction.y < 0) == (queue.rays[i - 1].direction.y < 0);
+        if (!same) runs++;
+    }
+    EXPECT_EQ(runs, 4);
+}
+
+TEST(RayQueue, sortedTileMatchesDepthFirstTile) {
+    Camera *camera = world_setup();
+    Tile tile;
+    tile.x0 = 480;
+    tile.y0 = 400;
+    tile.x1 = 544;
+    tile.y1 = 448;
+
+    std::vector<vec3> plain(tile.size()), sorted(tile.size());
+    RenderOptions options;
+    render_tile(camera, tile, &plain[0], options);
+    options.sort_rays = true;
+    render_tile(camera, tile, &sorted[0], options);
+    for (int p = 0; p < tile.size(); p++) {
+        EXPECT_EQ(plain[p], sorted[p]);
+    }
+    world_teardown(camera);
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <src/main.h>
+#include <atomic>
+#include <vector>
+
+//scene globals from main.cpp
+extern std::atomic<long> ROULETTE_KILLED;
+
+namespace {
+//mean of every channel over the whole image
+double render_mean(Camera *camera, const RenderOptions &options) {
+    std::vector<Tile> tiles = make_tiles(camera, TILE_SIZE);
+    double sum = 0.0;
+    int count = 0;
+    for (unsigned int t = 0; t < tiles.size(); t++) {
+        std::vector<vec3> rgb(tiles[t].size());
+        render_tile(camera, tiles[t], &rgb[0], options);
+        for (unsigned int p = 0; p < rgb.size(); p++) {
+            sum += rgb[p].r + rgb[p].g + rgb[p].b;
+            count += 3;
+        }
+    }
+    return sum / count;
+}
+
+TEST(Roulette, LeavesShallowPathsAlone) {
+    RenderOptions options;
+    options.width = 128;
+    options.height = 96;
+    Camera *camera = world_setup(options);
+    Tile tile = {32, 32, 64, 64};
+    std::vector<vec3> plain(tile.size()), roulette(tile.size());
+    render_tile(camera, tile, &plain[0], options);
+    options.roulette = true;
+    render_tile(camera, tile, &roulette[0], options);
+    for (int p = 0; p < tile.size(); p++) {
+        EXPECT_EQ(plain[p], roulette[p]);
+    }
+    world_teardown(camera);
+}
+
+TEST(Roulette, DeepPathsKeepTheirAverage) {
+    RenderOptions options;
+    options.width = 256;
+    options.height = 192;
+    options.instances = 2000;
+    options.reflections = 8;
+    Camera *camera = world_setup(options);
+
+    double full = render_mean(camera, options);
+    long killed = ROULETTE_KILLED;
+    options.roulette = true;
+    double roulette = render_mean(camera, options);
+    EXPECT_GT(ROULETTE_KILLED, killed);
+    EXPECT_NEAR(roulette, full, 0.005 * full);
+    world_teardown(camera);
+}
+
+} //namespace
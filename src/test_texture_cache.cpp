@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include <src/texture_cache.hpp>
+#include <src/texture.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+float TOLERANCE = 0.0001;
+
+//texel bytes are a function of position so any lookup can be checked
+unsigned char channel(int x, int y, int c) {
+    return (x * 7 + y * 13 + c * 50) & 0xff;
+}
+
+//stands in for FreeImage: "WxH" paths decode to a synthetic image
+struct SyntheticDecoder
+{
+    std::atomic<int> calls;
+    SyntheticDecoder() : calls(0) {}
+
+    bool operator()(const std::string &path, DecodedImage &image) {
+        calls++;
+        if (sscanf(path.c_str(), "%dx%d", &image.width, &image.height) != 2) {
+            return false;
+        }
+        image.rgb.resize(image.width * image.height * 3);
+        for (int y = 0; y < image.height; y++) {
+            for (int x = 0; x < image.width; x++) {
+                for (int c = 0; c < 3; c++) {
+                    image.rgb[(y * image.width + x) * 3 + c] = channel(x, y, c);
+                }
+            }
+        }
+        return true;
+    }
+};
+
+TextureCache::Decoder decoder_for(SyntheticDecoder &decoder) {
+    return [&decoder](const std::string &path, DecodedImage &image) { return decoder(path, image); };
+}
+
+void expect_texel(TextureCache &cache, const std::string &path, int x, int y) {
+    vec3 rgb;
+    ASSERT_TRUE(cache.texel(path, 0, x, y, rgb));
+    for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(rgb[c], channel(x, y, c) / 255.0, TOLERANCE);
+    }
+}
+
+TEST(TextureCache, TexelsMatchTheSourceImage) {
+    SyntheticDecoder decoder;
+    TextureCache cache(64 << 20, decoder_for(decoder));
+
+    //one past a page edge and the ragged last page
+    int xs[4] = {0, 63, 64, 199};
+    int ys[3] = {0, 64, 99};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 3; j++) {
+            expect_texel(cache, "200x100", xs[i], ys[j]);
+        }
+    }
+    //everything fit, so the first decode filled the rest
+    EXPECT_EQ(decoder.calls, 1);
+    EXPECT_GT(cache.hits, 0);
+
+    vec3 rgb;
+    EXPECT_FALSE(cache.texel("200x100", 0, 200, 0, rgb));
+    EXPECT_FALSE(cache.texel("200x100", 0, 0, -1, rgb));
+    EXPECT_FALSE(cache.texel("not an image", 0, 0, 0, rgb));
+    int w, h;
+    EXPECT_FALSE(cache.level_size("not an image", 0, w, h));
+}
+
+TEST(TextureCache, MipLevelsHalveAndAverage) {
+    SyntheticDecoder decoder;
+    TextureCache cache(64 << 20, decoder_for(decoder));
+
+    int w, h;
+    ASSERT_TRUE(cache.level_size("200x100", 0, w, h));
+    EXPECT_EQ(w, 200);
+    EXPECT_EQ(h, 100);
+    ASSERT_TRUE(cache.level_size("200x100", 1, w, h));
+    EXPECT_EQ(w, 100);
+    EXPECT_EQ(h, 50);
+    //the chain ends at 1x1
+    int level = 0;
+    while (cache.level_size("200x100", level + 1, w, h)) level++;
+    EXPECT_EQ(w, 1);
+    EXPECT_EQ(h, 1);
+    EXPECT_EQ(level, 7);
+
+    vec3 rgb;
+    ASSERT_TRUE(cache.texel("200x100", 1, 5, 3, rgb));
+    for (int c = 0; c < 3; c++) {
+        int sum = channel(10, 6, c) + channel(11, 6, c) + channel(10, 7, c) + channel(11, 7, c);
+        EXPECT_NEAR(rgb[c], ((sum + 2) / 4) / 255.0, TOLERANCE);
+    }
+}
+
+TEST(TextureCache, StaysUnderBudget) {
+    SyntheticDecoder decoder;
+    const size_t budget = 4 * TextureCache::PAGE_BYTES;
+    TextureCache cache(budget, decoder_for(decoder));
+
+    //8 x 4 pages at level 0, far more than fit
+    for (int y = 0; y < 256; y += 48) {
+        for (int x = 0; x < 512; x += 48) {
+            expect_texel(cache, "512x256", x, y);
+            EXPECT_LE(cache.resident_bytes(), budget);
+        }
+    }
+    EXPECT_GT(cache.evictions, 0);
+
+    //shrinking the budget evicts straight away
+    cache.set_budget(TextureCache::PAGE_BYTES);
+    EXPECT_EQ(cache.resident_bytes(), TextureCache::PAGE_BYTES);
+    cache.set_budget(0);
+    expect_texel(cache, "512x256", 300, 200);
+    EXPECT_EQ(cache.resident_bytes(), TextureCache::PAGE_BYTES);
+}
+
+TEST(TextureCache, KeepsPagesInUse) {
+    SyntheticDecoder decoder;
+    TextureCache cache(2 * TextureCache::PAGE_BYTES, decoder_for(decoder));
+
+    //a page that keeps getting sampled survives a stream of one-off pages
+    for (int tx = 1; tx < 16; tx++) {
+        expect_texel(cache, "1024x64", 0, 0);
+        expect_texel(cache, "1024x64", tx * 64, 0);
+    }
+    int decodes = decoder.calls;
+    expect_texel(cache, "1024x64", 10, 10);
+    EXPECT_EQ(decoder.calls, decodes);
+}
+
+TEST(TextureCache, EvictedPagesDontDecodeAgain) {
+    SyntheticDecoder decoder;
+    //no file directory, and room for a single page of a 4 x 4 page texture
+    TextureCache cache(TextureCache::PAGE_BYTES, decoder_for(decoder));
+    for (int pass = 0; pass < 3; pass++) {
+        for (int y = 0; y < 256; y += 64) {
+            for (int x = 0; x < 256; x += 64) {
+                expect_texel(cache, "256x256", x + 5, y + 3);
+            }
+        }
+    }
+    EXPECT_GT(cache.evictions, 0);
+    EXPECT_EQ(decoder.calls, 1);
+    EXPECT_EQ(cache.decodes, 1);
+    EXPECT_GT(cache.mapped, 0);
+}
+
+TEST(TextureCache, ConcurrentReadersSeeTheirTexels) {
+    SyntheticDecoder decoder;
+    //small enough that readers evict each other's pages
+    TextureCache cache(12 * TextureCache::PAGE_BYTES, decoder_for(decoder));
+
+    const int THREADS = 4;
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.push_back(std::thread([&cache, &wrong, t]() {
+            const char *paths[2] = {"256x256", "300x200"};
+            for (int i = 0; i < 500; i++) {
+                std::string path = paths[(i + t) % 2];
+                int x = (i * 37 + t * 101) % 256, y = (i * 11 + t * 7) % 200;
+                vec3 rgb;
+                if (!cache.texel(path, 0, x, y, rgb) ||
+                    std::abs(rgb.g - channel(x, y, 1) / 255.0) > TOLERANCE) {
+                    wrong++;
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < THREADS; t++) {
+        threads[t].join();
+    }
+    EXPECT_EQ(wrong, 0);
+    EXPECT_LE(cache.resident_bytes(), 12 * TextureCache::PAGE_BYTES);
+    EXPECT_EQ(cache.hits + cache.misses, THREADS * 500);
+}
+
+TEST(TextureManager, PreloadedTexturesDontMissOnFirstLookup) {
+    ThreadPool pool(3);
+    Profiler profiler;
+    std::vector<std::string> paths(1, "resources/test.png");
+    TextureManager::preload(paths, pool, profiler);
+    pool.wait();
+
+    int width, height;
+    ASSERT_TRUE(TextureManager::cache.level_size(paths[0], 0, width, height));
+    long misses = TextureManager::cache.misses;
+    vec3 rgb;
+    EXPECT_TRUE(TextureManager::get_uv_pixel_color(rgb, paths[0], 0.25, 0.75));
+    EXPECT_EQ(TextureManager::cache.misses, misses);
+}
+
+} //namespace
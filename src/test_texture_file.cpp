@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <src/texture_file.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+
+namespace {
+float TOLERANCE = 0.0001;
+
+unsigned char channel(int x, int y, int c) {
+    return (x * 5 + y * 11 + c * 70) & 0xff;
+}
+
+//source files hold "W H", decoding draws the synthetic image
+struct FileDecoder
+{
+    int calls = 0;
+
+    bool operator()(const std::string &path, DecodedImage &image) {
+        calls++;
+        std::ifstream in(path.c_str());
+        if (!(in >> image.width >> image.height)) {
+            return false;
+        }
+        image.rgb.resize(image.width * image.height * 3);
+        for (int y = 0; y < image.height; y++) {
+            for (int x = 0; x < image.width; x++) {
+                for (int c = 0; c < 3; c++) {
+                    image.rgb[(y * image.width + x) * 3 + c] = channel(x, y, c);
+                }
+            }
+        }
+        return true;
+    }
+};
+
+class TextureFileTest : public ::testing::Test {
+protected:
+    std::string dir;
+    std::string source;
+
+    void SetUp() {
+        char tmpl[] = "/tmp/rttx_test_XXXXXX";
+        dir = mkdtemp(tmpl);
+        source = dir + "/image.txt";
+        std::ofstream(source.c_str()) << "150 70";
+    }
+
+    void TearDown() {
+        //the directory only ever holds the source and .rttx files
+        std::string cmd = "rm -rf '" + dir + "'";
+        EXPECT_EQ(system(cmd.c_str()), 0);
+    }
+};
+
+TEST_F(TextureFileTest, HashFollowsContent) {
+    uint64_t a, b;
+    ASSERT_TRUE(TextureFile::content_hash(source, a));
+    std::ofstream((dir + "/copy.txt").c_str()) << "150 70";
+    ASSERT_TRUE(TextureFile::content_hash(dir + "/copy.txt", b));
+    EXPECT_EQ(a, b);
+    std::ofstream(source.c_str()) << "150 71";
+    ASSERT_TRUE(TextureFile::content_hash(source, b));
+    EXPECT_NE(a, b);
+    EXPECT_FALSE(TextureFile::content_hash(dir + "/missing", b));
+}
+
+TEST_F(TextureFileTest, SecondCacheReadsTheFileInsteadOfDecoding) {
+    FileDecoder decoder;
+    TextureCache::Decoder decode = [&decoder](const std::string &p, DecodedImage &i) { return decoder(p, i); };
+
+    std::vector<vec3> first;
+    {
+        TextureCache cache(64 << 20, decode);
+        cache.set_file_directory(dir);
+        for (int y = 0; y < 70; y += 23) {
+            for (int x = 0; x < 150; x += 31) {
+                vec3 rgb;
+                ASSERT_TRUE(cache.texel(source, 0, x, y, rgb));
+                first.push_back(rgb);
+            }
+        }
+        EXPECT_EQ(decoder.calls, 1);
+    }
+
+    //one page at a time so every lookup has to go back to the file
+    TextureCache cache(TextureCache::PAGE_BYTES, decode);
+    cache.set_file_directory(dir);
+    int w, h;
+    ASSERT_TRUE(cache.level_size(source, 1, w, h));
+    EXPECT_EQ(w, 75);
+    EXPECT_EQ(h, 35);
+    unsigned int i = 0;
+    for (int y = 0; y < 70; y += 23) {
+        for (int x = 0; x < 150; x += 31) {
+            vec3 rgb;
+            ASSERT_TRUE(cache.texel(source, 0, x, y, rgb));
+            for (int c = 0; c < 3; c++) {
+                EXPECT_NEAR(rgb[c], first[i][c], TOLERANCE);
+                EXPECT_NEAR(rgb[c], channel(x, y, c) / 255.0, TOLERANCE);
+            }
+            i++;
+        }
+    }
+    EXPECT_EQ(decoder.calls, 1);
+    EXPECT_GT(cache.mapped, 0);
+    vec3 rgb;
+    EXPECT_FALSE(cache.texel(source, 0, 150, 0, rgb));
+}
+
+TEST_F(TextureFileTest, DamagedFilesAreRebuilt) {
+    uint64_t hash;
+    ASSERT_TRUE(TextureFile::content_hash(source, hash));
+    std::string path = TextureFile::cache_path(dir, hash);
+    std::ofstream(path.c_str()) << "RTTX but cut short";
+    EXPECT_TRUE(TextureFile::open(path) == NULL);
+
+    FileDecoder decoder;
+    TextureCache cache(64 << 20, [&decoder](const std::string &p, DecodedImage &i) { return decoder(p, i); });
+    cache.set_file_directory(dir);
+    vec3 rgb;
+    ASSERT_TRUE(cache.texel(source, 0, 149, 69, rgb));
+    EXPECT_NEAR(rgb.b, channel(149, 69, 2) / 255.0, TOLERANCE);
+    EXPECT_EQ(decoder.calls, 1);
+
+    TextureFile *file = TextureFile::open(path);
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ(file->hash(), hash);
+    EXPECT_EQ(file->width(0), 150);
+    EXPECT_EQ(file->height(0), 70);
+    //(149, 69) sits in page (2, 1) at (21, 5)
+    const unsigned char *page = file->page(0, 2, 1);
+    EXPECT_EQ(page[(5 * TextureCache::PAGE_SIZE + 21) * 3 + 1], channel(149, 69, 1));
+    delete file;
+}
+
+} //namespace
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include <src/thread_pool.hpp>
+#include <atomic>
+#include <vector>
+
+TEST(ThreadPool, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+
+    std::vector<std::atomic<int> > visits(1000);
+    for (unsigned int i = 0; i < visits.size(); i++) visits[i] = 0;
+
+    //the pool is reused across calls, like across frames
+    for (int round = 0; round < 3; round++) {
+        pool.parallel_for(visits.size(), [&](int i) { visits[i]++; });
+    }
+    for (unsigned int i = 0; i < visits.size(); i++) {
+        EXPECT_EQ(visits[i], 3);
+    }
+
+    pool.parallel_for(0, [&](int i) { visits[i]++; });
+}
+
+TEST(ThreadPool, WaitsForSubmittedTasks) {
+    ThreadPool pool(3);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 100; i++) {
+        pool.submit([&count] { count++; });
+    }
+    pool.wait();
+    EXPECT_EQ(count, 100);
+}
+
+TEST(ThreadPool, SingleThreadRunsInline) {
+    ThreadPool pool(1);
+    int sum = 0;
+    pool.parallel_for(10, [&](int i) { sum += i; });
+    pool.submit([&sum] { sum += 100; });
+    pool.wait();
+    EXPECT_EQ(sum, 145);
+}
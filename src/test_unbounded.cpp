@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <src/unbounded.hpp>
+#include <src/bvh.hpp>
+#include <src/rng.hpp>
+#include <src/main.h>
+#include <cfloat>
+#include <vector>
+
+//scene globals from main.cpp
+extern BVH scene_bvh;
+extern UnboundedSet scene_unbounded;
+
+namespace {
+class UnboundedSetTest: public ::testing::Test
+{
+protected:
+    Plane *ground, *wall;
+    UnboundedSet set;
+
+    UnboundedSetTest() {
+        ground = new Plane(vec3(0.0, 1.0, 0.0), 1.0, vec4(1.0), 1.0);
+        wall = new Plane(glm::normalize(vec3(0.3, 0.0, 1.0)), 20.0, vec4(1.0), 1.0);
+        set.add(ground);
+        set.add(wall);
+    }
+
+    virtual ~UnboundedSetTest() {
+        delete ground;
+        delete wall;
+    }
+};
+
+TEST_F(UnboundedSetTest, PlaneKernelMatchesPlaneIntersects) {
+    RandomStream rs = RandomStream(5, 0, 0, 0, 0);
+    for (int i = 0; i < 2000; i++) {
+        vec3 origin = vec3(rs.next_float() * 4.0 - 2.0, rs.next_float() * 4.0 - 0.5, rs.next_float() * 4.0 - 2.0);
+        vec3 dir = vec3(rs.next_float() * 2.0 - 1.0, rs.next_float() * 2.0 - 1.0, rs.next_float() * 2.0 - 1.0);
+        Ray ray = Ray(origin, dir, RayType::camera);
+
+        HitRecord expected;
+        Plane *planes[2] = {ground, wall};
+        for (int p = 0; p < 2; p++) {
+            float t;
+            int prim;
+            if (planes[p]->intersects(ray, 0.0f, expected.t, t, prim)) {
+                expected.t = t;
+                expected.object = planes[p];
+            }
+        }
+
+        HitRecord closest;
+        EXPECT_EQ(set.intersect(ray, 0.0f, closest), expected.object != NULL);
+        EXPECT_EQ(closest.object, expected.object);
+        if (expected.object != NULL) {
+            EXPECT_EQ(closest.t, expected.t);
+        }
+    }
+}
+
+TEST_F(UnboundedSetTest, OnlyReplacesNearerHits) {
+    Ray ray = Ray(vec3(0.0), vec3(0.0, -1.0, -0.1), RayType::camera);
+    HitRecord closest;
+    closest.t = 0.5;
+    EXPECT_FALSE(set.intersect(ray, 0.0f, closest));
+    EXPECT_EQ(closest.object, (Object*)NULL);
+
+    closest.t = INFINITY;
+    EXPECT_TRUE(set.intersect(ray, 0.0f, closest));
+    EXPECT_EQ(closest.object, ground);
+}
+
+TEST_F(UnboundedSetTest, AmbientLightIsTheFallback) {
+    mat4 id = mat4(1.0);
+    Light ambient = Light(1.0, &id, vec4(1.0), 1.0, LightType::ambient);
+    set.add(&ambient);
+
+    //up and away from both planes
+    Ray up = Ray(vec3(0.0), vec3(0.0, 1.0, 0.1), RayType::shadow);
+    HitRecord closest;
+    EXPECT_TRUE(set.intersect(up, 0.0f, closest));
+    EXPECT_EQ(closest.object, &ambient);
+    EXPECT_EQ(closest.t, FLT_MAX);
+
+    Ray down = Ray(vec3(0.0), vec3(0.0, -1.0, 0.0), RayType::shadow);
+    closest = HitRecord();
+    EXPECT_TRUE(set.intersect(down, 0.0f, closest));
+    EXPECT_EQ(closest.object, ground);
+}
+
+TEST(UnboundedScene, CompiledSceneKeepsPlanesOutOfTheBVH) {
+    Camera *camera = world_setup();
+    EXPECT_FALSE(scene_bvh.nodes[0].box.is_infinite());
+    ASSERT_EQ(scene_unbounded.objects.size(), 1u);
+    EXPECT_EQ(scene_unbounded.objects[0]->type, ObjType::plane);
+    for (unsigned int i = 0; i < scene_bvh.prims.size(); i++) {
+        EXPECT_FALSE(scene_bvh.prims[i]->get_bounds().is_infinite());
+    }
+    world_teardown(camera);
+}
+
+} //namespace
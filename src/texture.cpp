@@ -1,18 +1,10 @@
 #include "src/texture.hpp"
-#include <iostream>
 //static
-std::map<std::string, FIBITMAP*> TextureManager::texture_handler_map;
+TextureCache TextureManager::cache(64 << 20, TextureManager::decode);
 
 //static
 //NOTE: load_image code adapted from FreeImaage manual
 FIBITMAP* TextureManager::load_image (const std::string& imagepath, int flag) {
-    //checkt the map first
-    auto it = texture_handler_map.find(imagepath);
-    if (it != texture_handler_map.end()) {
-        return it->second;
-    }
-    std::cout<<"had to load texture"<< std::endl;
-    //load
     FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
     const char* path = imagepath.c_str();
 
@@ -22,37 +14,70 @@ FIBITMAP* TextureManager::load_image (const std::string& imagepath, int flag) {
     }
 
     if ((fif != FIF_UNKNOWN) && FreeImage_FIFSupportsReading(fif)) {
-        //TODO:I don't know the scope of this pointer
-        FIBITMAP *file = FreeImage_Load(fif, path, flag);
-        texture_handler_map.insert(std::pair<std::string, FIBITMAP*> (imagepath, file));
-        return file;
+        return FreeImage_Load(fif, path, flag);
     }
     return NULL;
 }
 
 //static
-bool TextureManager::get_uv_pixel_color (vec3& rgb, const std::string& imagepath, const float& u, const float& v) {
-    if (imagepath == "") {
+bool TextureManager::decode (const std::string& imagepath, DecodedImage& image) {
+    FIBITMAP* file = load_image(imagepath, 0);
+    if (file == NULL) {
         return false;
     }
+    //FreeImage owns the bitmap, so it is charged by hand
+    unsigned int bitmap_bytes = FreeImage_GetDIBSize(file);
+    MemoryAccount::allocated(MemoryTag::textures, bitmap_bytes);
 
-    //lookup every time you need to set a value is bad
-    FIBITMAP* file = load_image(imagepath, 0);
-    if (file != NULL) {
-        unsigned int width = FreeImage_GetWidth(file);
-        unsigned int height = FreeImage_GetHeight(file);
-        unsigned int x = width * u;
-        unsigned int y = height * v;
-        RGBQUAD *color;
-        if (FreeImage_GetPixelColor(file, x, y, color)) {
-            rgb.r = color->rgbRed / 255.0;
-            rgb.g = color->rgbGreen / 255.0;
-            rgb.b = color->rgbBlue / 255.0;
-            return true;
-        } else {
-            return false;
+    image.width = FreeImage_GetWidth(file);
+    image.height = FreeImage_GetHeight(file);
+    image.rgb.resize(image.width * image.height * 3);
+    //rows stay in FreeImage order, bottom up, so v keeps its old meaning
+    RGBQUAD color;
+    unsigned char *out = image.rgb.data();
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            if (!FreeImage_GetPixelColor(file, x, y, &color)) {
+                color.rgbRed = color.rgbGreen = color.rgbBlue = 0;
+            }
+            *out++ = color.rgbRed;
+            *out++ = color.rgbGreen;
+            *out++ = color.rgbBlue;
         }
     }
-    return false;
+    MemoryAccount::released(MemoryTag::textures, bitmap_bytes);
+    FreeImage_Unload(file);
+    return true;
 }
 
+//static
+void TextureManager::preload (const std::vector<std::string>& paths, ThreadPool& pool, Profiler& profiler) {
+    Profiler::Path parent = profiler.path();
+    for (unsigned int i = 0; i < paths.size(); i++) {
+        std::string path = paths[i];
+        pool.submit([path, parent, &profiler]() {
+            ScopedTimer timer(profiler, "decode", parent);
+            //probing the size decodes the image and fills the budget with its pages
+            int width, height;
+            cache.level_size(path, 0, width, height);
+        });
+    }
+}
+
+//static
+bool TextureManager::get_uv_pixel_color (vec3& rgb, const std::string& imagepath, const float& u, const float& v) {
+    if (imagepath == "") {
+        return false;
+    }
+
+    int width, height;
+    if (!cache.level_size(imagepath, 0, width, height)) {
+        return false;
+    }
+    unsigned int x = width * u;
+    unsigned int y = height * v;
+    if (x >= (unsigned int)width || y >= (unsigned int)height) {
+        return false;
+    }
+    return cache.texel(imagepath, 0, x, y, rgb);
+}
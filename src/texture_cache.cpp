@@ -0,0 +1,357 @@
+#include "src/texture_cache.hpp"
+#include "src/texture_file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//static
+const int TextureCache::PAGE_SIZE;
+const int TextureCache::SHARDS;
+const size_t TextureCache::PAGE_BYTES;
+
+static void _read_texel(const unsigned char *page, int x, int y, vec3 &rgb) {
+    const unsigned char *t = &page[((y % TextureCache::PAGE_SIZE) * TextureCache::PAGE_SIZE + (x % TextureCache::PAGE_SIZE)) * 3];
+    rgb.r = t[0] / 255.0;
+    rgb.g = t[1] / 255.0;
+    rgb.b = t[2] / 255.0;
+}
+
+//levels written where no other process looks, the file is gone once unmapped
+static TextureFile* _spill(const std::vector<DecodedImage> &levels) {
+    static std::atomic<int> serial(0);
+    const char *dir = getenv("TMPDIR");
+    char name[64];
+    snprintf(name, sizeof(name), "/rt-spill.%d.%d.rttx", (int)getpid(), serial++);
+    std::string path = std::string(dir != NULL && *dir != '\0' ? dir : "/tmp") + name;
+    TextureFile *file = TextureFile::write(path, 0, levels) ? TextureFile::open(path) : NULL;
+    unlink(path.c_str());
+    return file;
+}
+
+TextureCache::TextureCache(size_t budget_bytes, Decoder decode)
+    : hits(0), misses(0), evictions(0), decodes(0), mapped(0), resident(0) {
+    decoder = decode;
+    max_bytes = budget_bytes;
+}
+
+TextureCache::~TextureCache() {
+    clear();
+    for (std::map<std::string, Texture*>::iterator it = textures.begin(); it != textures.end(); ++it) {
+        delete it->second->file;
+        delete it->second;
+    }
+}
+
+void TextureCache::set_file_directory(const std::string &dir) {
+    file_directory = dir;
+    if (!dir.empty() && mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror(dir.c_str());
+    }
+}
+
+void TextureCache::set_budget(size_t budget_bytes) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    max_bytes = budget_bytes;
+    while (resident > max_bytes && ring.size() > 1) {
+        evict_one();
+    }
+}
+
+void TextureCache::clear() {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    for (int s = 0; s < SHARDS; s++) {
+        std::lock_guard<std::mutex> shard_lock(shards[s].mutex);
+        for (std::unordered_map<uint64_t, Page*>::iterator it = shards[s].pages.begin(); it != shards[s].pages.end(); ++it) {
+            delete it->second;
+        }
+        shards[s].pages.clear();
+    }
+    ring.clear();
+    hand = 0;
+    resident = 0;
+}
+
+//static
+uint64_t TextureCache::page_key(int texture, int level, int tx, int ty) {
+    return ((uint64_t)(texture & 0xffff) << 47) | ((uint64_t)(level & 0x1f) << 42) |
+        ((uint64_t)(ty & 0x1fffff) << 21) | (uint64_t)(tx & 0x1fffff);
+}
+
+TextureCache::Shard& TextureCache::shard_for(uint64_t key) {
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    return shards[(h >> 32) % SHARDS];
+}
+
+TextureCache::Texture* TextureCache::texture(const std::string &path) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::map<std::string, Texture*>::iterator it = textures.find(path);
+    if (it != textures.end()) {
+        return it->second;
+    }
+    Texture *tex = new Texture();
+    tex->id = textures.size();
+    tex->probed = false;
+    textures[path] = tex;
+    return tex;
+}
+
+bool TextureCache::in_level(Texture *tex, int level, int x, int y) const {
+    return tex->ok && level >= 0 && level < (int)tex->widths.size() &&
+        x >= 0 && y >= 0 && x < tex->widths[level] && y < tex->heights[level];
+}
+
+bool TextureCache::lookup(uint64_t key, int x, int y, vec3 &rgb) {
+    Shard &shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, Page*>::iterator it = shard.pages.find(key);
+    if (it == shard.pages.end()) {
+        return false;
+    }
+    //copied out under the lock, eviction frees pages under the same lock
+    it->second->referenced = true;
+    _read_texel(&it->second->rgb[0], x, y, rgb);
+    return true;
+}
+
+bool TextureCache::level_size(const std::string &path, int level, int &width, int &height) {
+    Texture *tex = texture(path);
+    if (!tex->probed) {
+        page_in(tex, path, -1, 0, 0, NULL);
+    }
+    if (!tex->ok || level < 0 || level >= (int)tex->widths.size()) {
+        return false;
+    }
+    width = tex->widths[level];
+    height = tex->heights[level];
+    return true;
+}
+
+bool TextureCache::texel(const std::string &path, int level, int x, int y, vec3 &rgb) {
+    Texture *tex = texture(path);
+    if (tex->probed) {
+        if (!in_level(tex, level, x, y)) {
+            return false;
+        }
+        if (lookup(page_key(tex->id, level, x / PAGE_SIZE, y / PAGE_SIZE), x, y, rgb)) {
+            hits++;
+            return true;
+        }
+        if (tex->file != NULL) {
+            //no decode to wait for, the page is a copy out of the mapping
+            misses++;
+            return page_from_file(tex, level, x, y, rgb);
+        }
+    }
+    misses++;
+    return page_in(tex, path, level, x, y, &rgb);
+}
+
+//static
+void TextureCache::build_mips(const DecodedImage &image, std::vector<DecodedImage> &levels) {
+    //each level averages 2 x 2 texels of the one above, clamped at odd edges
+    levels.assign(1, image);
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const DecodedImage &src = levels.back();
+        DecodedImage dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.rgb.resize(dst.width * dst.height * 3);
+        for (int y = 0; y < dst.height; y++) {
+            int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++) {
+                int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                for (int c = 0; c < 3; c++) {
+                    int sum = src.rgb[(y0 * src.width + x0) * 3 + c] + src.rgb[(y0 * src.width + x1) * 3 + c] +
+                        src.rgb[(y1 * src.width + x0) * 3 + c] + src.rgb[(y1 * src.width + x1) * 3 + c];
+                    dst.rgb[(y * dst.width + x) * 3 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+        levels.push_back(dst);
+    }
+}
+
+//static
+void TextureCache::copy_page(const DecodedImage &level, int tx, int ty, unsigned char *out) {
+    memset(out, 0, PAGE_BYTES);
+    int x0 = tx * PAGE_SIZE, y0 = ty * PAGE_SIZE;
+    int w = std::min(PAGE_SIZE, level.width - x0);
+    for (int y = 0; y < PAGE_SIZE && y0 + y < level.height; y++) {
+        memcpy(&out[y * PAGE_SIZE * 3], &level.rgb[((y0 + y) * level.width + x0) * 3], w * 3);
+    }
+}
+
+//static
+TextureCache::Page* TextureCache::build_page(const DecodedImage &level, int tx, int ty) {
+    Page *page = new Page();
+    page->rgb.resize(PAGE_BYTES);
+    page->referenced = false;
+    copy_page(level, tx, ty, &page->rgb[0]);
+    return page;
+}
+
+bool TextureCache::page_from_file(Texture *tex, int level, int x, int y, vec3 &rgb) {
+    int tx = x / PAGE_SIZE, ty = y / PAGE_SIZE;
+    const unsigned char *src = tex->file->page(level, tx, ty);
+    Page *page = new Page();
+    page->rgb.assign(src, src + PAGE_BYTES);
+    page->referenced = true;
+    _read_texel(&page->rgb[0], x, y, rgb);
+    mapped++;
+    insert(page_key(tex->id, level, tx, ty), page, true);
+    return true;
+}
+
+//static
+void TextureCache::use_file(Texture *tex, TextureFile *file) {
+    tex->file = file;
+    tex->ok = true;
+    tex->widths.clear();
+    tex->heights.clear();
+    for (int l = 0; l < file->levels(); l++) {
+        tex->widths.push_back(file->width(l));
+        tex->heights.push_back(file->height(l));
+    }
+}
+
+bool TextureCache::page_in(Texture *tex, const std::string &path, int level, int x, int y, vec3 *rgb) {
+    std::lock_guard<std::mutex> decode_lock(tex->decode_mutex);
+    //another thread may have decoded it while we waited
+    uint64_t key = page_key(tex->id, level, x / PAGE_SIZE, y / PAGE_SIZE);
+    if (tex->probed) {
+        if (level < 0) return tex->ok;
+        if (!in_level(tex, level, x, y)) return false;
+        if (lookup(key, x, y, *rgb)) return true;
+        if (tex->file != NULL) return page_from_file(tex, level, x, y, *rgb);
+    }
+
+    //a texture file from an earlier run saves the decode entirely
+    uint64_t hash = 0;
+    bool hashed = !tex->probed && !file_directory.empty() && TextureFile::content_hash(path, hash);
+    if (hashed) {
+        TextureFile *file = TextureFile::open(TextureFile::cache_path(file_directory, hash));
+        if (file != NULL && file->hash() == hash) {
+            use_file(tex, file);
+            tex->probed = true;
+            if (level < 0) return true;
+            if (!in_level(tex, level, x, y)) return false;
+            return page_from_file(tex, level, x, y, *rgb);
+        }
+        delete file;
+    }
+
+    DecodedImage image;
+    decodes++;
+    bool ok = decoder(path, image) && image.width > 0 && image.height > 0;
+    std::vector<DecodedImage> levels;
+    if (ok) {
+        build_mips(image, levels);
+        image = DecodedImage(); //levels[0] holds a copy
+    }
+    if (!tex->probed) {
+        tex->ok = ok;
+        for (unsigned int l = 0; l < levels.size(); l++) {
+            tex->widths.push_back(levels[l].width);
+            tex->heights.push_back(levels[l].height);
+        }
+        //later misses read the file we just wrote instead of decoding again
+        if (ok && hashed) {
+            std::string file_path = TextureFile::cache_path(file_directory, hash);
+            TextureFile *file = TextureFile::write(file_path, hash, levels) ? TextureFile::open(file_path) : NULL;
+            if (file != NULL) {
+                use_file(tex, file);
+            }
+        }
+        if (ok && tex->file == NULL) {
+            TextureFile *file = _spill(levels);
+            if (file != NULL) {
+                use_file(tex, file);
+            }
+        }
+        tex->probed = true;
+    }
+    if (!ok) return false;
+
+    bool found = false;
+    if (level >= 0) {
+        if (!in_level(tex, level, x, y)) return false;
+        Page *page = build_page(levels[level], x / PAGE_SIZE, y / PAGE_SIZE);
+        page->referenced = true;
+        _read_texel(&page->rgb[0], x, y, *rgb);
+        insert(key, page, true);
+        found = true;
+    }
+
+    //the rest of the texture while there's room, coarse levels first since
+    //one of their pages covers the most of the image
+    for (int l = (int)levels.size() - 1; l >= 0; l--) {
+        int pages_x = (levels[l].width + PAGE_SIZE - 1) / PAGE_SIZE;
+        int pages_y = (levels[l].height + PAGE_SIZE - 1) / PAGE_SIZE;
+        for (int ty = 0; ty < pages_y; ty++) {
+            for (int tx = 0; tx < pages_x; tx++) {
+                if (resident + PAGE_BYTES > max_bytes) {
+                    return found || level < 0;
+                }
+                uint64_t other = page_key(tex->id, l, tx, ty);
+                Shard &shard = shard_for(other);
+                {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    if (shard.pages.count(other)) continue;
+                }
+                insert(other, build_page(levels[l], tx, ty), false);
+            }
+        }
+    }
+    return found || level < 0;
+}
+
+bool TextureCache::insert(uint64_t key, Page *page, bool evict) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    while (resident + PAGE_BYTES > max_bytes && !ring.empty()) {
+        if (!evict) {
+            delete page;
+            return false;
+        }
+        evict_one();
+    }
+
+    Shard &shard = shard_for(key);
+    std::lock_guard<std::mutex> shard_lock(shard.mutex);
+    if (shard.pages.count(key)) {
+        delete page;
+        return false;
+    }
+    shard.pages[key] = page;
+    ring.push_back(key);
+    resident += PAGE_BYTES;
+    return true;
+}
+
+//clock_mutex is held
+void TextureCache::evict_one() {
+    while (!ring.empty()) {
+        hand %= ring.size();
+        uint64_t key = ring[hand];
+        Shard &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::unordered_map<uint64_t, Page*>::iterator it = shard.pages.find(key);
+        if (it->second->referenced) {
+            //second chance
+            it->second->referenced = false;
+            hand++;
+            continue;
+        }
+        delete it->second;
+        shard.pages.erase(it);
+        ring[hand] = ring.back();
+        ring.pop_back();
+        resident -= PAGE_BYTES;
+        evictions++;
+        return;
+    }
+}
@@ -0,0 +1,181 @@
+#include "src/texture_file.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+//static
+const uint32_t TextureFile::VERSION;
+
+static const char MAGIC[4] = {'R', 'T', 'T', 'X'};
+static const int MAX_LEVELS = 32;
+
+struct _FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t levels;
+    uint64_t hash;
+};
+
+static int _pages_x(uint32_t width) {
+    return (width + TextureCache::PAGE_SIZE - 1) / TextureCache::PAGE_SIZE;
+}
+
+static int _pages_y(uint32_t height) {
+    return (height + TextureCache::PAGE_SIZE - 1) / TextureCache::PAGE_SIZE;
+}
+
+static bool _write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char*)buf;
+    while (len > 0) {
+        ssize_t r = ::write(fd, p, len);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+TextureFile::~TextureFile() {
+    if (data != NULL) {
+        munmap((void*)data, size);
+    }
+}
+
+//static
+bool TextureFile::content_hash(const std::string &path, uint64_t &hash) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL) {
+        return false;
+    }
+    hash = 0xcbf29ce484222325ull;
+    unsigned char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ buf[i]) * 0x100000001b3ull;
+        }
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+//static
+std::string TextureFile::cache_path(const std::string &dir, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rttx", (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+//static
+bool TextureFile::write(const std::string &file, uint64_t hash, const std::vector<DecodedImage> &levels) {
+    if (levels.empty() || (int)levels.size() > MAX_LEVELS) {
+        return false;
+    }
+    _FileHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.page_size = TextureCache::PAGE_SIZE;
+    header.levels = levels.size();
+    header.hash = hash;
+
+    std::vector<Level> table(levels.size());
+    uint64_t offset = sizeof(header) + table.size() * sizeof(Level);
+    for (unsigned int l = 0; l < levels.size(); l++) {
+        table[l].width = levels[l].width;
+        table[l].height = levels[l].height;
+        table[l].offset = offset;
+        offset += (uint64_t)_pages_x(table[l].width) * _pages_y(table[l].height) * TextureCache::PAGE_BYTES;
+    }
+
+    //unique per writer, two threads or processes can be converting the same image
+    static std::atomic<int> serial(0);
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%d.%d.tmp", (int)getpid(), serial++);
+    std::string tmp = file + suffix;
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(tmp.c_str());
+        return false;
+    }
+
+    bool ok = _write_full(fd, &header, sizeof(header)) &&
+        _write_full(fd, &table[0], table.size() * sizeof(Level));
+    std::vector<unsigned char> page(TextureCache::PAGE_BYTES);
+    for (unsigned int l = 0; ok && l < levels.size(); l++) {
+        for (int ty = 0; ok && ty < _pages_y(table[l].height); ty++) {
+            for (int tx = 0; ok && tx < _pages_x(table[l].width); tx++) {
+                TextureCache::copy_page(levels[l], tx, ty, &page[0]);
+                ok = _write_full(fd, &page[0], page.size());
+            }
+        }
+    }
+    ok = (::close(fd) == 0) && ok;
+    if (ok && rename(tmp.c_str(), file.c_str()) != 0) {
+        perror(file.c_str());
+        ok = false;
+    }
+    if (!ok) {
+        unlink(tmp.c_str());
+    }
+    return ok;
+}
+
+//static
+TextureFile* TextureFile::open(const std::string &file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(_FileHeader)) {
+        ::close(fd);
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    //the mapping keeps the file alive
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    TextureFile *tf = new TextureFile();
+    tf->data = (const unsigned char*)map;
+    tf->size = size;
+
+    //anything short or inconsistent is treated as missing and rebuilt
+    _FileHeader header;
+    memcpy(&header, tf->data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.page_size != (uint32_t)TextureCache::PAGE_SIZE ||
+        header.levels == 0 || header.levels > (uint32_t)MAX_LEVELS ||
+        size < sizeof(header) + header.levels * sizeof(Level)) {
+        delete tf;
+        return NULL;
+    }
+    tf->source_hash = header.hash;
+    tf->table.resize(header.levels);
+    memcpy(&tf->table[0], tf->data + sizeof(header), header.levels * sizeof(Level));
+    for (unsigned int l = 0; l < header.levels; l++) {
+        const Level &level = tf->table[l];
+        uint64_t bytes = (uint64_t)_pages_x(level.width) * _pages_y(level.height) * TextureCache::PAGE_BYTES;
+        if (level.width == 0 || level.height == 0 || level.offset > size || bytes > size - level.offset) {
+            delete tf;
+            return NULL;
+        }
+    }
+    return tf;
+}
+
+const unsigned char* TextureFile::page(int level, int tx, int ty) const {
+    const Level &l = table[level];
+    return data + l.offset + ((uint64_t)ty * _pages_x(l.width) + tx) * TextureCache::PAGE_BYTES;
+}
@@ -0,0 +1,94 @@
+#include "src/thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+    //the caller counts as one of the threads
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+//static
+int ThreadPool::hardware_threads() {
+    int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void ()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = tasks.front();
+            tasks.pop_front();
+            active++;
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            active--;
+            if (active == 0 && tasks.empty()) {
+                all_done.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void ()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    task_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this] { return active == 0 && tasks.empty(); });
+}
+
+void ThreadPool::parallel_for(int n, std::function<void (int)> body) {
+    std::atomic<int> next(0);
+    std::mutex done_mutex;
+    std::condition_variable done;
+    int exited = 0;
+
+    //every helper has to check out before we return, they all reference
+    //this stack frame
+    auto run = [&]() {
+        for (int i = next++; i < n; i = next++) {
+            body(i);
+        }
+        std::unique_lock<std::mutex> lock(done_mutex);
+        exited++;
+        done.notify_all();
+    };
+
+    int helpers = std::max(0, std::min((int)workers.size(), n - 1));
+    for (int i = 0; i < helpers; i++) {
+        submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return exited == helpers + 1; });
+}
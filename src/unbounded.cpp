@@ -0,0 +1,79 @@
+#include "src/unbounded.hpp"
+#include <cfloat>
+
+void UnboundedSet::clear() {
+    objects.clear();
+    nx.clear();
+    ny.clear();
+    nz.clear();
+    d.clear();
+    planes.clear();
+    ambient.clear();
+    others.clear();
+}
+
+void UnboundedSet::add(Object *obj) {
+    objects.push_back(obj);
+    if (obj->type == ObjType::plane) {
+        Plane *plane = (Plane*)obj;
+        nx.push_back(plane->n.x);
+        ny.push_back(plane->n.y);
+        nz.push_back(plane->n.z);
+        d.push_back(plane->D);
+        planes.push_back(obj);
+    }
+    else if (obj->type == ObjType::light && ((Light*)obj)->ltype == LightType::ambient) {
+        ambient.push_back(obj);
+    }
+    else if (obj->type == ObjType::light && ((Light*)obj)->ltype == LightType::directional) {
+        //never intersected, nothing to test
+    }
+    else {
+        others.push_back(obj);
+    }
+}
+
+bool UnboundedSet::intersect(const Ray &ray, float tmin, HitRecord &closest) const {
+    bool replaced = false;
+
+    //planes, same arithmetic as Plane::intersects
+    vec3 rd = glm::normalize(ray.direction);
+    vec3 o = ray.origin;
+    int best = -1;
+    float best_t = closest.t;
+    unsigned int n = planes.size();
+    for (unsigned int i = 0; i < n; i++) {
+        float vd = nx[i] * rd.x + ny[i] * rd.y + nz[i] * rd.z;
+        float t = -((nx[i] * o.x + ny[i] * o.y + nz[i] * o.z) + d[i]) / vd;
+        //parallel planes give inf or nan and fail the comparison
+        bool nearer = vd != 0.0f && t >= tmin && t < best_t;
+        best_t = nearer ? t : best_t;
+        best = nearer ? (int)i : best;
+    }
+    if (best >= 0) {
+        closest.t = best_t;
+        closest.object = planes[best];
+        closest.prim = 0;
+        replaced = true;
+    }
+
+    //ambient lights sit at FLT_MAX, see Light::intersects
+    if (!ambient.empty() && FLT_MAX >= tmin && FLT_MAX < closest.t) {
+        closest.t = FLT_MAX;
+        closest.object = ambient[0];
+        closest.prim = 0;
+        replaced = true;
+    }
+
+    for (unsigned int i = 0; i < others.size(); i++) {
+        float t;
+        int prim;
+        if (others[i]->intersects(ray, tmin, closest.t, t, prim)) {
+            closest.t = t;
+            closest.object = others[i];
+            closest.prim = prim;
+            replaced = true;
+        }
+    }
+    return replaced;
+}